@@ -1,6 +1,7 @@
 #include "lms.h"
 #include <chrono>
 #include <iomanip>
+#include <cstdlib>
 /*
 Account
 Create an Account class to track user activity. Each user has one account. The account must:
@@ -19,35 +20,47 @@ Account::Account(int userId) : userId(userId), fines(0), hasPaidFines(true) {}
 
 // Getters
 int Account::getUserId() const { return userId; }
-vector<string> Account::getBorrowedBooks() const { return borrowedBooks; }
-vector<string> Account::getBorrowHistory() const { return borrowHistory; }
+const vector<CopyId>& Account::getBorrowedBooks() const { return borrowedBooks; }
+const BookBitmap& Account::getBorrowHistory() const { return borrowHistory; }
 double Account::getFines() const { return fines; }
 bool Account::getHasPaidFines() const { return hasPaidFines; }
 
 // Setters
 void Account::setUserId(int userId) { this->userId = userId; }
-void Account::setBorrowedBooks(const vector<string>& books) { this->borrowedBooks = books; }
-void Account::setBorrowHistory(const vector<string>& history) { this->borrowHistory = history; }
+void Account::setBorrowedBooks(const vector<CopyId>& copies) { this->borrowedBooks = copies; }
+void Account::setBorrowHistory(const BookBitmap& history) { this->borrowHistory = history; }
 void Account::setFines(double fines) { this->fines = fines; }
 void Account::setHasPaidFines(bool paid) { this->hasPaidFines = paid; }
 
 // Account operations
-void Account::addBorrowedBook(const string& ISBN) {
-    borrowedBooks.push_back(ISBN);
+void Account::addBorrowedBook(CopyId copy) {
+    borrowedBooks.push_back(copy);
 }
-void Account::removeBorrowedBook(const string& ISBN) {
+void Account::removeBorrowedBook(CopyId copy) {
     for (auto it = borrowedBooks.begin(); it != borrowedBooks.end(); ++it) {
-        if (*it == ISBN) {
+        if (*it == copy) {
             borrowedBooks.erase(it);
             break;
         }
     }
+    for (auto it = fineLedger.begin(); it != fineLedger.end(); ++it) {
+        if (it->first == copy) {
+            fineLedger.erase(it);
+            break;
+        }
+    }
 }
-void Account::addToBorrowHistory(const string& ISBN) {
-    // Add to history only if it's not already there
-    if (find(borrowHistory.begin(), borrowHistory.end(), ISBN) == borrowHistory.end()) {
-        borrowHistory.push_back(ISBN);
+bool Account::findLoan(BookId book, CopyId& copy) const {
+    for (CopyId loan : borrowedBooks) {
+        if (loan.book == book) {
+            copy = loan;
+            return true;
+        }
     }
+    return false;
+}
+void Account::addToBorrowHistory(BookId book) {
+    borrowHistory.add(book); // the bitmap ignores books already in it
 }
 void Account::addFine(double amount) {
     this->fines += amount;
@@ -60,6 +73,24 @@ void Account::payFines() {
     this->hasPaidFines = true;
 }
 
+// Fine ledger
+time_t Account::getAccruedUntil(CopyId copy) const {
+    for (const auto& entry : fineLedger) {
+        if (entry.first == copy) return entry.second;
+    }
+    return 0;
+}
+void Account::setAccruedUntil(CopyId copy, time_t date) {
+    for (auto& entry : fineLedger) {
+        if (entry.first == copy) {
+            entry.second = date;
+            return;
+        }
+    }
+    fineLedger.emplace_back(copy, date);
+}
+const vector<pair<CopyId, time_t>>& Account::getFineLedger() const { return fineLedger; }
+
 // Display account details
 void Account::displayDetails() const {
     cout << "User ID: " << userId << endl;
@@ -69,97 +100,25 @@ void Account::displayDetails() const {
     cout << "Fines paid: " << (hasPaidFines ? "Yes" : "No") << endl;
     cout << endl;
 }
-void Account::displayBorrowedBooks(const map<string, Book>& books) const {
-    if (borrowedBooks.empty()) {
-        cout << "No books currently borrowed." << endl;
-        return;
-    }
-    
-    cout << "Currently borrowed books:" << endl;
-    cout << "-----------------------" << endl;
-    
-    for (const auto& isbn : borrowedBooks) {
-        auto it = books.find(isbn);
-        if (it != books.end()) {
-            cout << "ISBN: " << it->second.getISBN() << endl;
-            cout << "Title: " << it->second.getTitle() << endl;
-            
-            // Convert time_t to readable format using chrono
-            auto dueDate = chrono::system_clock::from_time_t(it->second.getDueDate());
-            time_t dueDateC = chrono::system_clock::to_time_t(dueDate);
-            cout << "Due date: " << put_time(localtime(&dueDateC), "%c %Z") << endl;
-        }
-    }
-    cout << endl;
-}
-void Account::displayBorrowHistory(const map<string, Book>& books) const {
-    if (borrowHistory.empty()) {
-        cout << "No borrowing history." << endl;
-        return;
-    }
-    
-    cout << "Borrowing history:" << endl;
-    cout << "-----------------" << endl;
-    
-    for (const auto& isbn : borrowHistory) {
-        auto it = books.find(isbn);
-        if (it != books.end()) {
-            cout << "ISBN: " << it->second.getISBN() << endl;
-            cout << "Title: " << it->second.getTitle() << endl;
-            cout << endl;
-        }
-    }
-}
 
 // File I/O
-void Account::saveToFile(ofstream& outFile) const {
+void Account::saveToFile(ostream& outFile, const BookIdTable& bookIds) const {
     outFile << userId << endl;
     outFile << fines << endl;
     outFile << (hasPaidFines ? "1" : "0") << endl;
     
     // Save borrowed books
     outFile << borrowedBooks.size() << endl;
-    for (const auto& isbn : borrowedBooks) {
-        outFile << isbn << endl;
+    for (CopyId loan : borrowedBooks) {
+        time_t accruedUntil = getAccruedUntil(loan);
+        outFile << bookIds.getISBN(loan.book) << '#' << loan.copy + 1;
+        if (accruedUntil != 0) outFile << '\t' << accruedUntil;
+        outFile << endl;
     }
     
     // Save borrow history
     outFile << borrowHistory.size() << endl;
-    for (const auto& isbn : borrowHistory) {
-        outFile << isbn << endl;
+    for (BookId id : borrowHistory.toVector()) {
+        outFile << bookIds.getISBN(id) << endl;
     }
 }
-
-Account Account::loadFromFile(ifstream& inFile) {
-    Account account;
-    int numBooks = 0;
-    string line;
-    account.userId = 0;
-    account.fines = 0.0;
-    int paid = 0;
-    
-    inFile >> account.userId;
-    inFile >> account.fines;
-    inFile >> paid;
-    account.hasPaidFines = (paid == 1);
-    
-    // Load borrowed books
-    inFile >> numBooks;
-    inFile.ignore(); // Ignore newline after numBooks
-    
-    for (int i = 0; i < numBooks; ++i) {
-        getline(inFile, line);
-        account.borrowedBooks.push_back(line);
-    }
-    
-    // Load borrow history
-    inFile >> numBooks;
-    inFile.ignore(); // Ignore newline after numBooks
-    
-    for (int i = 0; i < numBooks; ++i) {
-        getline(inFile, line);
-        account.borrowHistory.push_back(line);
-    }
-    
-    return account;
-}
@@ -0,0 +1,508 @@
+#include "lms.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+
+/*
+Benchmarks for the Library operations.
+
+    ./bench generate <dir> <books> <users> [<historyPerUser>]
+        Write books.txt, users.txt and accounts.txt for a synthetic library into dir.
+        Borrow histories and current loans follow a Zipf distribution over the
+        catalog, so a few titles are very popular and most are rarely borrowed.
+
+    ./bench run <dir> [<iterations>]
+        Load the library in dir and report ns/op and allocations/op for
+        loadData, saveData, searchBooks, borrowBook, returnBook and calculateFines.
+        The data in dir is modified (loans, fines, snapshot, journal).
+
+    ./bench stress <dir> [<threads>] [<opsPerThread>]
+        Run borrows, returns, searches and listings of all loans from several
+        threads at once against a small set of popular books, then check that
+        books, accounts and the due-date index still agree. The listings must
+        each show one point in time. Exits non-zero on any inconsistency.
+
+    ./bench import <dir> [<books>] [<users>]
+        Write books.csv and users.csv with new books and students into dir, load
+        the library in dir (made by generate) and import both files as its
+        librarian (ID 1001), reporting rows/s. The data in dir is modified.
+*/
+using namespace std;
+
+// ----- Allocation counting -----
+
+static atomic<uint64_t> allocationCount(0);
+
+// Every form of operator new and delete is replaced, so each allocation is
+// counted and freed by the matching function. They are all kept out of line:
+// inlined, GCC would see malloc() or free() paired with the operator and warn
+// (-Wmismatched-new-delete).
+static void* countedAlloc(size_t size, size_t alignment) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (size == 0) size = 1;
+    void* p = nullptr;
+    if (alignment <= alignof(max_align_t)) p = malloc(size);
+    else if (posix_memalign(&p, alignment, size) != 0) p = nullptr;
+    return p;
+}
+static void* countedNew(size_t size, size_t alignment) {
+    if (void* p = countedAlloc(size, alignment)) return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new(size_t size) { return countedNew(size, 0); }
+__attribute__((noinline)) void* operator new[](size_t size) { return countedNew(size, 0); }
+__attribute__((noinline)) void* operator new(size_t size, align_val_t al) {
+    return countedNew(size, static_cast<size_t>(al));
+}
+__attribute__((noinline)) void* operator new[](size_t size, align_val_t al) {
+    return countedNew(size, static_cast<size_t>(al));
+}
+__attribute__((noinline)) void* operator new(size_t size, const nothrow_t&) noexcept {
+    return countedAlloc(size, 0);
+}
+__attribute__((noinline)) void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return countedAlloc(size, 0);
+}
+__attribute__((noinline)) void* operator new(size_t size, align_val_t al, const nothrow_t&) noexcept {
+    return countedAlloc(size, static_cast<size_t>(al));
+}
+__attribute__((noinline)) void* operator new[](size_t size, align_val_t al, const nothrow_t&) noexcept {
+    return countedAlloc(size, static_cast<size_t>(al));
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+
+// ----- Dataset generation -----
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s
+class ZipfSampler {
+private:
+    vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double s) : cdf(n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / pow(static_cast<double>(i + 1), s);
+            cdf[i] = sum;
+        }
+        for (auto& value : cdf) value /= sum;
+    }
+    size_t operator()(mt19937_64& rng) const {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return min(static_cast<size_t>(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()), cdf.size() - 1);
+    }
+};
+
+// Valid ISBN-13 with the 978 prefix for serial number n
+static string makeISBN(uint64_t n) {
+    string serial = to_string(n % 1000000000ULL);
+    string digits = "978" + string(9 - serial.size(), '0') + serial;
+    int sum = 0;
+    for (int i = 0; i < 12; ++i)
+        sum += (digits[i] - '0') * (i % 2 == 0 ? 1 : 3);
+    digits += static_cast<char>('0' + (10 - sum % 10) % 10);
+    return digits;
+}
+
+static const char* WORDS[] = {"Shadow", "River", "Garden", "Empire", "Silent", "Winter", "Code", "Stars",
+                              "Fire", "Ocean", "Night", "Journey", "Secret", "Kingdom", "Glass", "Storm",
+                              "Memory", "Iron", "Golden", "Forest", "Machine", "Dream", "Lost", "City"};
+static const char* NAMES[] = {"Asha", "Rohan", "Meera", "Vikram", "Priya", "Arjun", "Kavya", "Nikhil",
+                              "Sara", "Dev", "Isha", "Kabir", "Tara", "Aman", "Neha", "Rahul"};
+static const char* PUBLISHERS[] = {"Penguin", "HarperCollins", "Vintage", "Scholastic", "Bloomsbury",
+                                   "Macmillan", "Random House", "Oxford University Press"};
+
+static string pick(const char* const* list, size_t size, mt19937_64& rng) {
+    return list[uniform_int_distribution<size_t>(0, size - 1)(rng)];
+}
+
+static int generate(const string& dir, size_t numBooks, size_t numUsers, size_t historyPerUser) {
+    filesystem::create_directories(dir);
+    mt19937_64 rng(42);
+    const size_t numWords = sizeof(WORDS) / sizeof(WORDS[0]);
+    const size_t numNames = sizeof(NAMES) / sizeof(NAMES[0]);
+    const size_t numPublishers = sizeof(PUBLISHERS) / sizeof(PUBLISHERS[0]);
+    time_t now = time(nullptr);
+
+    vector<Book> books;
+    BookIdTable bookIds; // book i gets BookId i
+    books.reserve(numBooks);
+    for (size_t i = 0; i < numBooks; ++i) {
+
+        string title = pick(WORDS, numWords, rng) + " " + pick(WORDS, numWords, rng) + " " + to_string(i);
+        string author = pick(NAMES, numNames, rng) + " " + pick(WORDS, numWords, rng);
+        int year = uniform_int_distribution<int>(1900, 2024)(rng);
+        // The most popular titles (lowest IDs under the Zipf distribution) have several copies
+        size_t copies = i < numBooks / 100 ? 3 : 1;
+        books.emplace_back(title, author, pick(PUBLISHERS, numPublishers, rng), year, makeISBN(i + 1), copies);
+        uint64_t key;
+        parseISBN(books.back().getISBN(), key);
+        bookIds.intern(key);
+    }
+
+    // One librarian, 10% faculty, the rest students
+    vector<User> users;
+    users.reserve(numUsers);
+    for (size_t i = 0; i < numUsers; ++i) {
+        UserRole role = (i == 0) ? UserRole::Librarian : (i % 10 == 0 ? UserRole::Faculty : UserRole::Student);
+        int id = (role == UserRole::Librarian) ? 1001 : (role == UserRole::Faculty ? 500000 : 1000000) + static_cast<int>(i);
+        string name = pick(NAMES, numNames, rng) + " " + pick(NAMES, numNames, rng);
+        users.emplace_back(id, name, "user" + to_string(id) + "@example.com", "password" + to_string(id), role);
+    }
+
+    ZipfSampler zipf(numBooks, 1.0);
+    vector<Account> accounts;
+    accounts.reserve(numUsers);
+    for (const User& user : users) {
+        Account account(user.getId());
+        if (user.getRole() != UserRole::Librarian) {
+            BookBitmap history;
+            for (size_t j = 0; j < historyPerUser; ++j)
+                history.add(static_cast<BookId>(zipf(rng)));
+            account.setBorrowHistory(history);
+
+            // Current loans: up to one fewer than the limit, some of them overdue
+            const RolePolicy& policy = rolePolicy(user.getRole());
+            int maxLoans = policy.maxBooks - 1;
+            int period = policy.loanDays * 60;
+            int loans = uniform_int_distribution<int>(0, maxLoans)(rng);
+            for (int j = 0; j < loans; ++j) {
+                BookId id = static_cast<BookId>(zipf(rng));
+                Book& book = books[id];
+                uint32_t copy;
+                CopyId held;
+                if (account.findLoan(id, held) || !book.findFreeCopy(copy)) continue;
+                time_t borrowed = now - uniform_int_distribution<int>(0, 2 * period)(rng);
+                BookCopy state;
+                state.setStatus(BookStatus::Borrowed);
+                state.setBorrowerId(user.getId());
+                state.setBorrowDate(borrowed);
+                state.setDueDate(borrowed + period);
+                book.setCopy(copy, state);
+                account.addBorrowedBook(CopyId{id, copy});
+                account.addToBorrowHistory(id);
+            }
+        }
+        accounts.push_back(account);
+    }
+
+    ofstream booksFile(dir + "/books.txt");
+    ofstream usersFile(dir + "/users.txt");
+    ofstream accountsFile(dir + "/accounts.txt");
+    ofstream copiesFile(dir + "/copies.txt");
+    if (!booksFile || !usersFile || !accountsFile || !copiesFile) {
+        cerr << "Error: Unable to write to " << dir << endl;
+        return 1;
+    }
+    for (const auto& book : books) {
+        book.saveToFile(booksFile);
+        for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+            const BookCopy& copy = book.getCopy(i);
+            if (copy.getStatus() == BookStatus::Available) continue;
+            copiesFile << book.getISBN() << '\t' << i + 1 << '\t' << copy.getStatusName() << '\t'
+                       << copy.getBorrowerId() << '\t' << copy.getBorrowDate() << '\t' << copy.getDueDate() << '\n';
+        }
+    }
+    for (const auto& user : users) user.saveToFile(usersFile);
+    for (const auto& account : accounts) account.saveToFile(accountsFile, bookIds);
+
+    // A stale snapshot or journal would shadow the new text files
+    filesystem::remove(dir + "/library.snap");
+    filesystem::remove(dir + "/journal.log");
+    cout << "Generated " << numBooks << " books and " << numUsers << " users in " << dir << endl;
+    return 0;
+}
+
+// ----- Microbenchmarks -----
+
+// Discards everything the Library prints while an operation is measured
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+static void report(const string& name, size_t iterations, chrono::nanoseconds elapsed, uint64_t allocations) {
+    cout << left << setw(16) << name << right << setw(10) << iterations
+         << setw(16) << fixed << setprecision(0) << static_cast<double>(elapsed.count()) / iterations
+         << setw(16) << setprecision(1) << static_cast<double>(allocations) / iterations << endl;
+}
+
+// Measure body(i) for i in [0, iterations)
+static void measure(const string& name, size_t iterations, const function<void(size_t)>& body) {
+    if (iterations == 0) return;
+    NullBuffer null;
+    streambuf* coutBuf = cout.rdbuf(&null);
+    streambuf* cerrBuf = cerr.rdbuf(&null);
+    uint64_t allocationsBefore = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        body(i);
+    auto elapsed = chrono::steady_clock::now() - start;
+    uint64_t allocations = allocationCount.load() - allocationsBefore;
+    cout.rdbuf(coutBuf);
+    cerr.rdbuf(cerrBuf);
+    report(name, iterations, chrono::duration_cast<chrono::nanoseconds>(elapsed), allocations);
+}
+
+static int run(const string& dir, size_t iterations) {
+    // Read the keys from the text files once, to choose the benchmark inputs
+    vector<string> isbns;
+    vector<string> titles;
+    vector<string> authors;
+    vector<int> studentIds;
+    {
+        ifstream booksFile(dir + "/books.txt");
+        while (booksFile.peek() != EOF) {
+            Book book = Book::loadFromFile(booksFile);
+            if (!booksFile) break;
+            isbns.push_back(book.getISBN());
+            titles.push_back(book.getTitle());
+            authors.push_back(book.getAuthor());
+        }
+        ifstream usersFile(dir + "/users.txt");
+        User user;
+        while (usersFile.peek() != EOF && User::loadFromFile(usersFile, user)) {
+            if (user.getRole() == UserRole::Student) studentIds.push_back(user.getId());
+        }
+    }
+    if (isbns.empty()) {
+        cerr << "Error: no books found in " << dir << " (run 'bench generate' first)" << endl;
+        return 1;
+    }
+
+    cout << left << setw(16) << "operation" << right << setw(10) << "ops"
+         << setw(16) << "ns/op" << setw(16) << "allocs/op" << endl;
+
+    filesystem::remove(dir + "/library.snap");
+    measure("loadData(text)", 1, [&](size_t) { Library library(dir); });
+    measure("loadData(snap)", 3, [&](size_t) { Library library(dir); });
+
+    Library library(dir);
+    mt19937_64 rng(7);
+
+    measure("saveData", 3, [&](size_t) { library.saveData(); });
+
+    vector<string> keywords;
+    for (size_t i = 0; i < iterations; ++i) {
+        const string& title = titles[uniform_int_distribution<size_t>(0, titles.size() - 1)(rng)];
+        keywords.push_back(title.substr(0, title.find(' ')));
+    }
+    measure("searchBooks", iterations, [&](size_t i) { library.searchBooks(keywords[i]); });
+
+    // One 20-book page of a sorted listing, rendered as in the menus
+    const BookOrder orders[] = {BookOrder::ISBN, BookOrder::Title, BookOrder::Author, BookOrder::Year};
+    uniform_int_distribution<size_t> pickOffset(0, titles.size() > 20 ? titles.size() - 20 : 0);
+    measure("listBooks(page)", iterations, [&](size_t i) {
+        Library::displayBookPage(library.listBooks(orders[i % 4], pickOffset(rng), 20));
+    });
+
+    // Secondary indexes: all books of an author, and of a ten-year range
+    measure("booksByAuthor", iterations, [&](size_t i) { library.booksByAuthor(authors[i * 7919 % authors.size()]); });
+    measure("booksByYear", iterations, [&](size_t i) { library.booksByYear(1950 + i % 60, 1959 + i % 60); });
+
+    // Pair students that may borrow with books that are available
+    vector<pair<int, string>> loans;
+    {
+        size_t next = 0;
+        for (size_t i = 0; i < studentIds.size() && loans.size() < iterations; ++i) {
+            int id = studentIds[i];
+            Account* account = library.findAccount(id);
+            if (!account || account->getFines() > 0 ||
+                account->getBorrowedBooks().size() >= static_cast<size_t>(rolePolicy(UserRole::Student).maxBooks))
+                continue;
+            while (next < isbns.size()) {
+                Book* book = library.findBook(isbns[next++]);
+                if (book && book->getAvailableCount() > 0) {
+                    loans.emplace_back(id, book->getISBN());
+                    break;
+                }
+            }
+        }
+    }
+    measure("borrowBook", loans.size(), [&](size_t i) { library.borrowBook(loans[i].first, loans[i].second); });
+    measure("returnBook", loans.size(), [&](size_t i) { library.returnBook(loans[i].first, loans[i].second); });
+
+    measure("calculateFines", 1, [&](size_t) { library.calculateFines(); });
+    // Same minute again: the fine ledger leaves nothing to charge
+    measure("recalculateFines", 1, [&](size_t) { library.calculateFines(); });
+    return 0;
+}
+
+// ----- Concurrency stress test -----
+
+static int stress(const string& dir, size_t threadCount, size_t opsPerThread) {
+    Library library(dir);
+    vector<int> studentIds;
+    vector<string> hotBooks;
+    {
+        // Loans and searches all go through the public API; the setup only reads
+        ifstream usersFile(dir + "/users.txt");
+        User user;
+        while (usersFile.peek() != EOF && User::loadFromFile(usersFile, user)) {
+            Account* account = library.findAccount(user.getId());
+            if (user.getRole() == UserRole::Student && account && account->getFines() == 0)
+                studentIds.push_back(user.getId());
+        }
+        ifstream booksFile(dir + "/books.txt");
+        while (booksFile.peek() != EOF && hotBooks.size() < 4 * threadCount) {
+            Book book = Book::loadFromFile(booksFile);
+            if (!booksFile) break;
+            Book* current = library.findBook(book.getISBN());
+            if (current && current->getAvailableCount() > 0)
+                hotBooks.push_back(book.getISBN());
+        }
+    }
+    if (studentIds.size() < threadCount || hotBooks.empty()) {
+        cerr << "Error: not enough students or available books in " << dir << endl;
+        return 1;
+    }
+
+    NullBuffer null;
+    streambuf* coutBuf = cout.rdbuf(&null);
+    streambuf* cerrBuf = cerr.rdbuf(&null);
+    atomic<uint64_t> borrows(0), returns(0), searches(0), listings(0), tornListings(0);
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&, t] {
+            mt19937_64 rng(t + 1);
+            // Each thread acts for its own students, so it knows their loans
+            vector<int> ownStudents;
+            for (size_t i = t; i < studentIds.size(); i += threadCount)
+                ownStudents.push_back(studentIds[i]);
+            vector<pair<int, string>> loans;
+            for (size_t op = 0; op < opsPerThread; ++op) {
+                unsigned kind = uniform_int_distribution<unsigned>(0, 9)(rng);
+                if (kind == 0 && op % 50 == 0) {
+                    // All loans by due date, read from one view: no student may
+                    // be seen with more loans than allowed, as could happen if
+                    // books were read at different times around a return and a borrow
+                    BookPage page = library.listBooks(BookOrder::DueDate, 0, SIZE_MAX);
+                    unordered_map<int, int> loansOf;
+                    set<string> seen;
+                    for (const Book& book : page.books) {
+                        if (!seen.insert(book.getISBN()).second) continue; // one entry per copy out
+                        for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+                            if (book.getCopy(i).getStatus() == BookStatus::Borrowed)
+                                ++loansOf[book.getCopy(i).getBorrowerId()];
+                        }
+                    }
+                    for (int id : ownStudents) {
+                        auto it = loansOf.find(id);
+                        if (it != loansOf.end() && it->second > rolePolicy(UserRole::Student).maxBooks) ++tornListings;
+                    }
+                    ++listings;
+                } else if (kind == 0) {
+                    library.searchBooks(hotBooks[uniform_int_distribution<size_t>(0, hotBooks.size() - 1)(rng)]);
+                    ++searches;
+                } else if (kind < 5 || loans.empty()) {
+                    int id = ownStudents[uniform_int_distribution<size_t>(0, ownStudents.size() - 1)(rng)];
+                    const string& isbn = hotBooks[uniform_int_distribution<size_t>(0, hotBooks.size() - 1)(rng)];
+                    if (library.borrowBook(id, isbn)) {
+                        loans.emplace_back(id, isbn);
+                        ++borrows;
+                    }
+                } else {
+                    size_t index = uniform_int_distribution<size_t>(0, loans.size() - 1)(rng);
+                    if (library.returnBook(loans[index].first, loans[index].second)) ++returns;
+                    loans[index] = loans.back();
+                    loans.pop_back();
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout.rdbuf(coutBuf);
+    cerr.rdbuf(cerrBuf);
+    size_t problems = library.verifyConsistency(cout) + tornListings;
+    cout << threadCount << " threads, " << threadCount * opsPerThread << " operations in "
+         << fixed << setprecision(3) << seconds << " s (" << setprecision(0)
+         << threadCount * opsPerThread / seconds << " ops/s): " << borrows << " borrows, "
+         << returns << " returns, " << searches << " searches, " << listings << " listings, " << problems
+         << " inconsistencies" << endl;
+    library.displayPerformanceReport(); // includes the checkpoints taken meanwhile
+    return problems == 0 ? 0 : 1;
+}
+
+static int import(const string& dir, size_t numBooks, size_t numUsers) {
+    mt19937_64 rng(7);
+    const size_t numWords = sizeof(WORDS) / sizeof(WORDS[0]);
+    const size_t numNames = sizeof(NAMES) / sizeof(NAMES[0]);
+    const size_t numPublishers = sizeof(PUBLISHERS) / sizeof(PUBLISHERS[0]);
+    {
+        // Serials and IDs above the ones generate uses; every 8th title needs quoting
+        ofstream books(dir + "/books.csv");
+        books << "title,author,publisher,year,ISBN,copies\n";
+        for (size_t i = 0; i < numBooks; ++i) {
+            string title = pick(WORDS, numWords, rng) + " " + pick(WORDS, numWords, rng) + " " + to_string(i);
+            if (i % 8 == 0) title = "\"" + title + ", Volume 2\"";
+            books << title << ',' << pick(NAMES, numNames, rng) << ' ' << pick(WORDS, numWords, rng) << ','
+                  << pick(PUBLISHERS, numPublishers, rng) << ',' << uniform_int_distribution<int>(1900, 2024)(rng)
+                  << ',' << makeISBN(500000000 + i) << ',' << 1 + i % 3 << '\n';
+        }
+        ofstream users(dir + "/users.csv");
+        users << "role,id,name,email,password\n";
+        for (size_t i = 0; i < numUsers; ++i) {
+            int id = 5000000 + static_cast<int>(i);
+            users << "Student," << id << ',' << pick(NAMES, numNames, rng) << ' ' << pick(NAMES, numNames, rng)
+                  << ",user" << id << "@example.com,password" << id << '\n';
+        }
+    }
+
+    Library library(dir);
+    NullBuffer null;
+    streambuf* coutBuf = cout.rdbuf(&null);
+    bool loggedIn = library.login(1001, "password1001");
+    cout.rdbuf(coutBuf);
+    if (!loggedIn) {
+        cerr << "Error: cannot log in as librarian 1001 in " << dir << endl;
+        return 1;
+    }
+    bool ok = library.importBooksCsv(dir + "/books.csv") && library.importUsersCsv(dir + "/users.csv");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 1 ? argv[1] : "";
+    if (command == "generate" && (argc == 5 || argc == 6)) {
+        size_t history = argc == 6 ? stoul(argv[5]) : 20;
+        return generate(argv[2], stoul(argv[3]), stoul(argv[4]), history);
+    }
+    if (command == "run" && (argc == 3 || argc == 4)) {
+        return run(argv[2], argc == 4 ? stoul(argv[3]) : 1000);
+    }
+    if (command == "stress" && argc >= 3 && argc <= 5) {
+        return stress(argv[2], argc >= 4 ? stoul(argv[3]) : 4, argc == 5 ? stoul(argv[4]) : 10000);
+    }
+    if (command == "import" && argc >= 3 && argc <= 5) {
+        return import(argv[2], argc >= 4 ? stoul(argv[3]) : 200000, argc == 5 ? stoul(argv[4]) : 50000);
+    }
+    cerr << "Usage: " << argv[0] << " generate <dir> <books> <users> [<historyPerUser>]\n"
+         << "       " << argv[0] << " run <dir> [<iterations>]\n"
+         << "       " << argv[0] << " stress <dir> [<threads>] [<opsPerThread>]\n"
+         << "       " << argv[0] << " import <dir> [<books>] [<users>]" << endl;
+    return 2;
+}
@@ -0,0 +1,188 @@
+#include "lms.h"
+#include <cstring>
+#include <functional>
+// BookBitmap class implementation
+using namespace std;
+
+namespace {
+
+const uint16_t ARRAY_CONTAINER = 0;
+const uint16_t BITMAP_CONTAINER = 1;
+
+template <typename T>
+void appendRaw(string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readRaw(const char*& data, const char* end, T& value) {
+    if (static_cast<size_t>(end - data) < sizeof(value)) return false;
+    memcpy(&value, data, sizeof(value));
+    data += sizeof(value);
+    return true;
+}
+
+inline bool testBit(const vector<uint64_t>& bits, uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+} // namespace
+
+BookBitmap::BookBitmap() : count(0) {}
+
+const BookBitmap::Container* BookBitmap::findContainer(uint16_t high) const {
+    auto it = lower_bound(containers.begin(), containers.end(), high,
+                          [](const Container& c, uint16_t h) { return c.high < h; });
+    return (it != containers.end() && it->high == high) ? &*it : nullptr;
+}
+
+bool BookBitmap::add(BookId id) {
+    uint16_t high = static_cast<uint16_t>(id >> 16);
+    uint16_t low = static_cast<uint16_t>(id & 0xFFFF);
+    auto it = lower_bound(containers.begin(), containers.end(), high,
+                          [](const Container& c, uint16_t h) { return c.high < h; });
+    if (it == containers.end() || it->high != high)
+        it = containers.insert(it, Container{high, 0, {}, {}});
+    Container& c = *it;
+
+    if (!c.bits.empty()) {
+        uint64_t& word = c.bits[low >> 6];
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (word & mask) return false;
+        word |= mask;
+    } else {
+        auto pos = lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos != c.array.end() && *pos == low) return false;
+        c.array.insert(pos, low);
+        if (c.array.size() > ARRAY_MAX) {
+            // Convert to a bitmap; it is now the smaller representation
+            c.bits.assign(BITMAP_WORDS, 0);
+            for (uint16_t value : c.array)
+                c.bits[value >> 6] |= uint64_t(1) << (value & 63);
+            vector<uint16_t>().swap(c.array);
+        }
+    }
+    ++c.cardinality;
+    ++count;
+    return true;
+}
+
+bool BookBitmap::contains(BookId id) const {
+    const Container* c = findContainer(static_cast<uint16_t>(id >> 16));
+    if (!c) return false;
+    uint16_t low = static_cast<uint16_t>(id & 0xFFFF);
+    if (!c->bits.empty()) return testBit(c->bits, low);
+    return binary_search(c->array.begin(), c->array.end(), low);
+}
+
+size_t BookBitmap::size() const { return count; }
+BookId BookBitmap::maxId() const {
+    const Container& c = containers.back();
+    BookId base = static_cast<BookId>(c.high) << 16;
+    if (c.bits.empty()) return base | c.array.back();
+    size_t w = BITMAP_WORDS;
+    while (c.bits[--w] == 0) {}
+    return base | static_cast<BookId>(w * 64 + 63 - __builtin_clzll(c.bits[w]));
+}
+bool BookBitmap::empty() const { return count == 0; }
+void BookBitmap::clear() {
+    containers.clear();
+    count = 0;
+}
+
+vector<BookId> BookBitmap::toVector() const {
+    vector<BookId> ids;
+    ids.reserve(count);
+    for (const auto& c : containers) {
+        BookId base = static_cast<BookId>(c.high) << 16;
+        if (c.bits.empty()) {
+            for (uint16_t low : c.array) ids.push_back(base | low);
+            continue;
+        }
+        for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+            for (uint64_t word = c.bits[w]; word; word &= word - 1)
+                ids.push_back(base | static_cast<BookId>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    return ids;
+}
+
+BookBitmap BookBitmap::intersect(const BookBitmap& other) const {
+    BookBitmap result;
+    for (const auto& c : containers) {
+        const Container* o = other.findContainer(c.high);
+        if (!o) continue;
+        BookId base = static_cast<BookId>(c.high) << 16;
+        if (!c.bits.empty() && !o->bits.empty()) {
+            for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+                for (uint64_t word = c.bits[w] & o->bits[w]; word; word &= word - 1)
+                    result.add(base | static_cast<BookId>(w * 64 + __builtin_ctzll(word)));
+            }
+        } else {
+            // Walk the array side and probe the other container
+            const Container& small = c.bits.empty() ? c : *o;
+            const Container& large = c.bits.empty() ? *o : c;
+            for (uint16_t low : small.array) {
+                bool present = large.bits.empty() ? binary_search(large.array.begin(), large.array.end(), low)
+                                                  : testBit(large.bits, low);
+                if (present) result.add(base | low);
+            }
+        }
+    }
+    return result;
+}
+
+void BookBitmap::serialize(string& out) const {
+    appendRaw(out, static_cast<uint32_t>(containers.size()));
+    for (const auto& c : containers) {
+        appendRaw(out, c.high);
+        appendRaw(out, c.bits.empty() ? ARRAY_CONTAINER : BITMAP_CONTAINER);
+        appendRaw(out, c.cardinality);
+        if (c.bits.empty())
+            out.append(reinterpret_cast<const char*>(c.array.data()), c.array.size() * sizeof(uint16_t));
+        else
+            out.append(reinterpret_cast<const char*>(c.bits.data()), BITMAP_WORDS * sizeof(uint64_t));
+    }
+}
+
+bool BookBitmap::deserialize(const char* data, size_t size) {
+    clear();
+    const char* end = data + size;
+    uint32_t containerCount;
+    if (!readRaw(data, end, containerCount)) return false;
+    for (uint32_t i = 0; i < containerCount; ++i) {
+        Container c{0, 0, {}, {}};
+        uint16_t kind;
+        if (!readRaw(data, end, c.high) || !readRaw(data, end, kind) || !readRaw(data, end, c.cardinality) ||
+            c.cardinality == 0 || (!containers.empty() && c.high <= containers.back().high)) {
+            clear();
+            return false;
+        }
+        if (kind == ARRAY_CONTAINER && c.cardinality <= ARRAY_MAX &&
+            static_cast<size_t>(end - data) >= c.cardinality * sizeof(uint16_t)) {
+            c.array.resize(c.cardinality);
+            memcpy(c.array.data(), data, c.cardinality * sizeof(uint16_t));
+            data += c.cardinality * sizeof(uint16_t);
+            if (adjacent_find(c.array.begin(), c.array.end(), greater_equal<uint16_t>()) != c.array.end()) {
+                clear();
+                return false;
+            }
+        } else if (kind == BITMAP_CONTAINER && static_cast<size_t>(end - data) >= BITMAP_WORDS * sizeof(uint64_t)) {
+            c.bits.resize(BITMAP_WORDS);
+            memcpy(c.bits.data(), data, BITMAP_WORDS * sizeof(uint64_t));
+            data += BITMAP_WORDS * sizeof(uint64_t);
+            size_t bitsSet = 0;
+            for (uint64_t word : c.bits) bitsSet += __builtin_popcountll(word);
+            if (bitsSet != c.cardinality) {
+                clear();
+                return false;
+            }
+        } else {
+            clear();
+            return false;
+        }
+        count += c.cardinality;
+        containers.push_back(move(c));
+    }
+    return data == end;
+}
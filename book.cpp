@@ -1,5 +1,4 @@
 #include "lms.h"
-#include <chrono>
 #include <iomanip>
 // Book class implementation
 /*
@@ -14,24 +13,116 @@ Constraints:
 */
 using namespace std;
 
-Book::Book() : year(0), borrowerId(0), borrowDate(0), dueDate(0) {
-    status = "Available";
+string bookStatusName(BookStatus status) {
+    switch (status) {
+        case BookStatus::Available: return "Available";
+        case BookStatus::Borrowed: return "Borrowed";
+        case BookStatus::Reserved: return "Reserved";
+    }
+    return "Available";
+}
+bool bookStatusFromName(string_view name, BookStatus& status) {
+    if (name == "Available") status = BookStatus::Available;
+    else if (name == "Borrowed") status = BookStatus::Borrowed;
+    else if (name == "Reserved") status = BookStatus::Reserved;
+    else return false;
+    return true;
+}
+
+bool parseISBN(string_view text, uint64_t& key) {
+    char digits[13];
+    size_t count = 0;
+    for (char c : text) {
+        if (c == '-' || c == ' ') continue;
+        bool checkX = (c == 'X' || c == 'x') && count == 9; // ISBN-10 check digit 10
+        if ((c < '0' || c > '9') && !checkX) return false;
+        if (count == 13) return false;
+        digits[count++] = checkX ? 'X' : c;
+    }
+    if (count == 10) {
+        // ISBN-10: sum of digit * (10 - position) must be divisible by 11
+        int sum = 0;
+        for (size_t i = 0; i < 10; ++i)
+            sum += (digits[i] == 'X' ? 10 : digits[i] - '0') * static_cast<int>(10 - i);
+        if (sum % 11 != 0) return false;
+        // Same book as ISBN-13: prefix 978 and recompute the check digit
+        uint64_t value = 978;
+        int check = 9 + 3 * 7 + 8;
+        for (size_t i = 0; i < 9; ++i) {
+            value = value * 10 + (digits[i] - '0');
+            check += (digits[i] - '0') * (i % 2 == 0 ? 3 : 1);
+        }
+        key = value * 10 + (10 - check % 10) % 10;
+        return true;
+    }
+    if (count != 13 || digits[9] == 'X') return false;
+    // ISBN-13: digits weighted 1, 3, 1, 3, ... must sum to a multiple of 10
+    int sum = 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < 13; ++i) {
+        sum += (digits[i] - '0') * (i % 2 == 0 ? 1 : 3);
+        value = value * 10 + (digits[i] - '0');
+    }
+    if (sum % 10 != 0) return false;
+    key = value;
+    return true;
+}
+string formatISBN(uint64_t key) {
+    string text(13, '0');
+    for (size_t i = 13; i-- > 0; key /= 10)
+        text[i] = static_cast<char>('0' + key % 10);
+    return text;
+}
+
+BookId BookIdTable::intern(uint64_t key) {
+    auto inserted = ids.emplace(key, static_cast<BookId>(keys.size()));
+    if (inserted.second) keys.push_back(key);
+    return inserted.first->second;
+}
+bool BookIdTable::find(uint64_t key, BookId& id) const {
+    auto it = ids.find(key);
+    if (it == ids.end()) return false;
+    id = it->second;
+    return true;
+}
+bool BookIdTable::contains(BookId id) const { return id < keys.size(); }
+uint64_t BookIdTable::getKey(BookId id) const { return keys[id]; }
+string BookIdTable::getISBN(BookId id) const { return formatISBN(keys[id]); }
+const vector<uint64_t>& BookIdTable::getKeys() const { return keys; }
+size_t BookIdTable::size() const { return keys.size(); }
+void BookIdTable::clear() {
+    ids.clear();
+    keys.clear();
+}
+
+BookCopy::BookCopy() : status(BookStatus::Available), borrowerId(0), borrowDate(0), dueDate(0) {}
+
+BookStatus BookCopy::getStatus() const { return status; }
+string BookCopy::getStatusName() const { return bookStatusName(status); }
+int BookCopy::getBorrowerId() const { return borrowerId; }
+time_t BookCopy::getBorrowDate() const { return borrowDate; }
+time_t BookCopy::getDueDate() const { return dueDate; }
+
+void BookCopy::setStatus(BookStatus status) { this->status = status; }
+void BookCopy::setBorrowerId(int id) { this->borrowerId = id; }
+void BookCopy::setBorrowDate(time_t date) { this->borrowDate = date; }
+void BookCopy::setDueDate(time_t date) { this->dueDate = date; }
+
+Book::Book() : year(0) {
+    setCopyCount(1);
 }
-Book::Book(const string& title, const string& author, const string& publisher, int year, const string& ISBN)
-    : title(title), author(author), publisher(publisher), year(year), ISBN(ISBN), borrowerId(0), borrowDate(0), dueDate(0) {
-    status = "Available";
+Book::Book(const string& title, const string& author, const string& publisher, int year, const string& ISBN,
+           size_t copyCount)
+    : title(title), author(author), publisher(publisher), year(year), ISBN(ISBN) {
+    setCopyCount(copyCount);
 }
 
 // Getters
-string Book::getTitle() const { return title; }
-string Book::getAuthor() const { return author; }
-string Book::getPublisher() const { return publisher; }
+const string& Book::getTitle() const { return title; }
+const string& Book::getAuthor() const { return author; }
+const string& Book::getPublisher() const { return publisher; }
 int Book::getYear() const { return year; }
-string Book::getISBN() const { return ISBN; }
-string Book::getStatus() const { return status; }
-int Book::getBorrowerId() const { return borrowerId; }
-time_t Book::getBorrowDate() const { return borrowDate; }
-time_t Book::getDueDate() const { return dueDate; }
+const string& Book::getISBN() const { return ISBN; }
 
 // Setters
 void Book::setTitle(const string& title) { this->title = title; }
@@ -39,50 +130,124 @@ void Book::setAuthor(const string& author) { this->author = author; }
 void Book::setPublisher(const string& publisher) { this->publisher = publisher; }
 void Book::setYear(int year) { this->year = year; }
 void Book::setISBN(const string& ISBN) { this->ISBN = ISBN; }
-void Book::setStatus(const string& status) { this->status = status; }
-void Book::setBorrowerId(int id) { this->borrowerId = id; }
-void Book::setBorrowDate(time_t date) { this->borrowDate = date; }
-void Book::setDueDate(time_t date) { this->dueDate = date; }
+
+// Copies
+size_t Book::getCopyCount() const { return copies.size(); }
+size_t Book::getAvailableCount() const { return freeCopies.size(); }
+const BookCopy& Book::getCopy(uint32_t copy) const { return copies[copy]; }
+const vector<BookCopy>& Book::getCopies() const { return copies; }
+void Book::setCopy(uint32_t copy, const BookCopy& state) {
+    copies[copy] = state;
+    updateFreeList(copy);
+}
+void Book::setCopies(const vector<BookCopy>& states) {
+    copies.clear();
+    freeCopies.clear();
+    freeSlot.clear();
+    setCopyCount(states.size());
+    for (uint32_t copy = 0; copy < states.size(); ++copy) setCopy(copy, states[copy]);
+}
+bool Book::findFreeCopy(uint32_t& copy) const {
+    if (freeCopies.empty()) return false;
+    copy = freeCopies.back();
+    return true;
+}
+// Put copy on the free list or take it off, whichever matches its status
+void Book::updateFreeList(uint32_t copy) {
+    bool available = copies[copy].getStatus() == BookStatus::Available;
+    if (available && freeSlot[copy] == NOT_FREE) {
+        freeSlot[copy] = static_cast<uint32_t>(freeCopies.size());
+        freeCopies.push_back(copy);
+    } else if (!available && freeSlot[copy] != NOT_FREE) {
+        unlistFree(copy);
+    }
+}
+// Take copy off the free list by moving the last entry into its place
+void Book::unlistFree(uint32_t copy) {
+    uint32_t last = freeCopies.back();
+    freeCopies[freeSlot[copy]] = last;
+    freeSlot[last] = freeSlot[copy];
+    freeCopies.pop_back();
+    freeSlot[copy] = NOT_FREE;
+}
+bool Book::setCopyCount(size_t count) {
+    for (size_t copy = count; copy < copies.size(); ++copy) {
+        if (copies[copy].getStatus() != BookStatus::Available) return false;
+    }
+    while (copies.size() > count) {
+        unlistFree(static_cast<uint32_t>(copies.size() - 1)); // it is Available
+        copies.pop_back();
+        freeSlot.pop_back();
+    }
+    // New copies are listed from the last down, so the lowest one is lent first
+    size_t added = copies.size();
+    copies.resize(count);
+    freeSlot.resize(count, NOT_FREE);
+    for (size_t copy = count; copy > added; --copy) updateFreeList(static_cast<uint32_t>(copy - 1));
+    return true;
+}
 
 // Display book details
 void Book::displayDetails() const {
-    cout << "ISBN: " << ISBN << endl;
-    cout << "Title: " << title << endl;
-    cout << "Author: " << author << endl;
-    cout << "Publisher: " << publisher << endl;
-    cout << "Year: " << year << endl;
-    cout << "Status: " << status << endl;
-    
-    if (status == "Borrowed") {
-        // Convert time_t to readable format using chrono
-        auto borrowDateChrono = chrono::system_clock::from_time_t(borrowDate);
-        auto dueDateChrono = chrono::system_clock::from_time_t(dueDate);
-        time_t borrowDateC = chrono::system_clock::to_time_t(borrowDateChrono);
-        time_t dueDateC = chrono::system_clock::to_time_t(dueDateChrono);
-        
-        cout << "Borrowed by: " << borrowerId << endl;
-        cout << "Borrow date: " << put_time(localtime(&borrowDateC), "%c %Z") << endl;
-        cout << "Due date: " << put_time(localtime(&dueDateC), "%c %Z") << endl;
+    string text;
+    appendDetails(text);
+    cout << text;
+}
+// Builds the whole block in memory; listings append many books and write once.
+// A single copy is shown as before; with several, every copy that is out gets a line.
+void Book::appendDetails(string& out) const {
+    auto date = [](time_t when) {
+        char text[64];
+        tm local;
+        localtime_r(&when, &local);
+        return string(text, strftime(text, sizeof(text), "%c %Z", &local));
+    };
+    out += "ISBN: " + ISBN + "\n";
+    out += "Title: " + title + "\n";
+    out += "Author: " + author + "\n";
+    out += "Publisher: " + publisher + "\n";
+    out += "Year: " + to_string(year) + "\n";
+
+    if (copies.size() == 1) {
+        const BookCopy& copy = copies[0];
+        out += "Status: " + copy.getStatusName() + "\n";
+        if (copy.getStatus() == BookStatus::Borrowed) {
+            out += "Borrowed by: " + to_string(copy.getBorrowerId()) + "\n";
+            out += "Borrow date: " + date(copy.getBorrowDate()) + "\n";
+            out += "Due date: " + date(copy.getDueDate()) + "\n";
+        } else if (copy.getStatus() == BookStatus::Reserved) {
+            out += "Reserved for: " + to_string(copy.getBorrowerId()) + "\n";
+            out += "Held until: " + date(copy.getDueDate()) + "\n";
+        }
+    } else {
+        out += "Copies: " + to_string(copies.size()) + " (" + to_string(freeCopies.size()) + " available)\n";
+        for (size_t i = 0; i < copies.size(); ++i) {
+            const BookCopy& copy = copies[i];
+            if (copy.getStatus() == BookStatus::Borrowed)
+                out += "Copy " + to_string(i + 1) + ": borrowed by " + to_string(copy.getBorrowerId()) +
+                       ", due " + date(copy.getDueDate()) + "\n";
+            else if (copy.getStatus() == BookStatus::Reserved)
+                out += "Copy " + to_string(i + 1) + ": reserved for " + to_string(copy.getBorrowerId()) +
+                       " until " + date(copy.getDueDate()) + "\n";
+        }
     }
-    cout << endl;
+    out += "\n";
 }
 
-// File I/O
-void Book::saveToFile(ofstream& outFile) const {
+// File I/O: the bibliographic record and the number of copies; the state of
+// the copies is written to copies.txt by the Library
+void Book::saveToFile(ostream& outFile) const {
     outFile << title << endl;
     outFile << author << endl;
     outFile << publisher << endl;
     outFile << year << endl;
     outFile << ISBN << endl;
-    outFile << status << endl;
-    outFile << borrowerId << endl;
-    outFile << borrowDate << endl;
-    outFile << dueDate << endl;
+    outFile << copies.size() << endl;
 }
 
 Book Book::loadFromFile(ifstream& inFile) {
     Book book;
-    string line;
+    size_t copyCount = 1;
     
     getline(inFile, book.title);
     getline(inFile, book.author);
@@ -90,11 +255,9 @@ Book Book::loadFromFile(ifstream& inFile) {
     inFile >> book.year;
     inFile.ignore(); // Ignore newline after year
     getline(inFile, book.ISBN);
-    getline(inFile, book.status);
-    inFile >> book.borrowerId;
-    inFile >> book.borrowDate;
-    inFile >> book.dueDate;
-    inFile.ignore(); // Ignore newline after dueDate
+    inFile >> copyCount;
+    inFile.ignore(); // Ignore newline after the number of copies
+    book.setCopyCount(max<size_t>(copyCount, 1));
     
     return book;
 }
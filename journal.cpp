@@ -0,0 +1,181 @@
+#include "lms.h"
+#include <filesystem>
+// Journal class implementation
+/*
+Each line of journal.log is one operation:
+    <seq>\t<operation>\t<arg1>\t<arg2>...
+Backslash, tab and newline inside arguments are escaped as \\, \t and \n.
+A checkpoint renames journal.log to journal.log.prev when it takes its
+snapshot, and deletes journal.log.prev once the snapshot is on disk.
+*/
+using namespace std;
+
+namespace {
+
+string escapeField(const string& field) {
+    string out;
+    out.reserve(field.size());
+    for (char c : field) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+void appendLine(string& out, uint64_t seq, const vector<string>& fields) {
+    out += to_string(seq);
+    for (const auto& field : fields) {
+        out += '\t';
+        out += escapeField(field);
+    }
+    out += '\n';
+}
+
+vector<string> splitLine(const string& line) {
+    vector<string> fields(1);
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '\t') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            char next = line[++i];
+            fields.back() += (next == 't') ? '\t' : (next == 'n') ? '\n' : next;
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+} // namespace
+
+Journal::Journal() : nextSeq(1), pendingEntries(0) {}
+
+string Journal::rotatedPath(const string& path) {
+    return path + ".prev";
+}
+
+vector<JournalEntry> Journal::readEntries(const string& path) {
+    vector<JournalEntry> entries;
+    // A rotated file is left only by a checkpoint that did not finish
+    error_code ec;
+    if (filesystem::exists(rotatedPath(path), ec)) entries = readFile(rotatedPath(path));
+    vector<JournalEntry> current = readFile(path);
+    entries.insert(entries.end(), make_move_iterator(current.begin()), make_move_iterator(current.end()));
+    return entries;
+}
+
+vector<JournalEntry> Journal::readFile(const string& path) {
+    vector<JournalEntry> entries;
+    ifstream inFile(path, ios::binary);
+    if (!inFile) return entries;
+
+    string line;
+    uint64_t validBytes = 0;
+    while (getline(inFile, line)) {
+        if (inFile.eof()) break; // last line has no newline: torn write
+        validBytes += line.size() + 1;
+        vector<string> fields = splitLine(line);
+        if (fields.size() < 2) continue;
+        JournalEntry entry;
+        try {
+            entry.seq = stoull(fields[0]);
+        } catch (const exception&) {
+            continue;
+        }
+        fields.erase(fields.begin());
+        entry.fields = move(fields);
+        entries.push_back(move(entry));
+    }
+    inFile.close();
+
+    error_code ec;
+    if (filesystem::file_size(path, ec) > validBytes && !ec) {
+        cerr << "Warning: discarding incomplete last entry of " << path << endl;
+        filesystem::resize_file(path, validBytes, ec);
+    }
+    return entries;
+}
+
+bool Journal::open(const string& path, uint64_t lastSeq, size_t pendingEntries) {
+    this->path = path;
+    this->nextSeq = lastSeq + 1;
+    this->pendingEntries = pendingEntries;
+    if (outFile.is_open()) outFile.close();
+    outFile.open(path, ios::binary | ios::app);
+    return outFile.is_open();
+}
+
+bool Journal::isOpen() const {
+    return outFile.is_open();
+}
+
+bool Journal::append(const vector<string>& fields) {
+    if (!outFile.is_open()) return false;
+    string line;
+    appendLine(line, nextSeq, fields);
+    outFile.write(line.data(), line.size());
+    outFile.flush();
+    if (!outFile) return false;
+    ++nextSeq;
+    ++pendingEntries;
+    return true;
+}
+
+bool Journal::appendAll(const vector<vector<string>>& entries) {
+    if (!outFile.is_open()) return false;
+    string lines;
+    for (size_t i = 0; i < entries.size(); ++i)
+        appendLine(lines, nextSeq + i, entries[i]);
+    outFile.write(lines.data(), lines.size());
+    outFile.flush();
+    if (!outFile) return false;
+    nextSeq += entries.size();
+    pendingEntries += entries.size();
+    return true;
+}
+
+// If the previous rotated file is still there (its checkpoint failed), the
+// current entries are appended to it instead of renaming over it, so it holds
+// every entry up to this checkpoint either way.
+bool Journal::rotate() {
+    if (outFile.is_open()) outFile.close();
+    error_code ec;
+    bool rotated;
+    if (filesystem::exists(rotatedPath(path), ec)) {
+        rotated = true;
+        if (filesystem::file_size(path, ec) > 0 && !ec) {
+            ifstream current(path, ios::binary);
+            ofstream older(rotatedPath(path), ios::binary | ios::app);
+            older << current.rdbuf();
+            older.flush();
+            rotated = current && older;
+        }
+        if (rotated) filesystem::remove(path, ec);
+    } else {
+        filesystem::rename(path, rotatedPath(path), ec);
+        rotated = !ec;
+    }
+    outFile.open(path, ios::binary | ios::app);
+    if (rotated) pendingEntries = 0;
+    return rotated;
+}
+
+void Journal::dropRotated() {
+    error_code ec;
+    filesystem::remove(rotatedPath(path), ec);
+}
+
+uint64_t Journal::getLastSeq() const {
+    return nextSeq - 1;
+}
+
+bool Journal::needsCompaction() const {
+    return pendingEntries >= COMPACT_THRESHOLD;
+}
+
+bool Journal::hasPendingEntries() const {
+    return pendingEntries > 0;
+}
@@ -5,21 +5,35 @@
 #include <limits>
 #include <chrono>
 #include <iomanip>
+#include <functional>
+#include <cstdio>
 
 using namespace std;
 
 // Library class implementation
-Library::Library(const string& dataDir) : currentUserId(0), dataDirectory(dataDir){
+Library::Library(const string& dataDir)
+    : currentUserId(0), dataDirectory(dataDir), catalogOrder(books, bookIds) {
     filesystem::create_directories(dataDirectory);     // Create data directory if it doesn't exist.
+    vector<string> roleErrors;
+    loadRolePolicies(dataDirectory + "/roles.txt", roleErrors); // Borrowing rules; built-in ones without the file
+    for (const string& error : roleErrors) cerr << "Warning: " << error << endl;
     loadData();                                             // Load data from files if they exist.
+    checkpointThread = thread(&Library::checkpointLoop, this);
 }
 
 // Destructor
 Library::~Library() {
+    {
+        lock_guard<mutex> checkpointGuard(checkpointMutex);
+        stopCheckpoints = true;
+    }
+    checkpointWake.notify_one();
+    checkpointThread.join();
     saveData();                                             // Save data to files before exiting.
-    for (auto& pair : users)
-        delete pair.second;                                 // Free memory allocated for User objects
+    if (!metricsPath.empty() && !metrics.writeFile(metricsPath))
+        cerr << "Error: Unable to write " << metricsPath << "." << endl;
     books.clear();
+    bookIds.clear();
     users.clear();
     accounts.clear();
 }
@@ -32,54 +46,378 @@ void Library::clearScreen() {
         system("clear"); // Clear screen for Linux and MacOS
     #endif
 }
-void Library::saveData() {
-    ofstream booksFile(dataDirectory + "/books.txt");
-    ofstream usersFile(dataDirectory + "/users.txt");
-    ofstream accountsFile(dataDirectory + "/accounts.txt");
+// Problems of a checkpoint go to stderr through stdio, one message at a time:
+// saveData runs on the checkpoint thread, and cerr may meanwhile be pointed
+// elsewhere by the thread running commands (batch mode captures it).
+static void reportCheckpointError(const char* message) {
+    static mutex stderrMutex;
+    lock_guard<mutex> stderrGuard(stderrMutex);
+    fprintf(stderr, "%s\n", message);
+    fflush(stderr);
+}
 
-    if (!booksFile || !usersFile || !accountsFile) {
-        cerr << "Error: Unable to open files for saving data." << endl;
-        return;
+// Checkpoint in three steps. The book details and users only change under the
+// exclusive lock, so they are serialized under the shared lock while loans go
+// on (again if a librarian changed them meanwhile). The loans are captured
+// under the exclusive lock and the journal rotated at the same point; the
+// snapshot is then written unlocked and the rotated journal dropped once it is
+// on disk. After a crash at any point the old snapshot and both journal files,
+// or the new snapshot and the new journal, hold everything.
+void Library::saveData() {
+    OperationTimer timer(metrics, Operation::SaveData);
+    lock_guard<mutex> saveGuard(saveMutex);
+    SnapshotImage image;
+    bool rotated;
+    while (true) {
+        uint64_t capturedChanges;
+        {
+            shared_lock<shared_mutex> catalogLock(catalogMutex);
+            capturedChanges = catalogChanges;
+            image = Snapshot::captureCatalog(bookIds, books, users);
+        }
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        if (catalogChanges != capturedChanges) continue;
+        lock_guard<mutex> journalGuard(journalMutex);
+        OperationTimer pause(metrics, Operation::CheckpointPause); // loans wait this long
+        Snapshot::captureLoans(image, books, accounts, holdQueues, journal.getLastSeq());
+        rotated = journal.rotate();
+        break;
     }
-    for (const auto& pair : books) {
-        pair.second.saveToFile(booksFile);
+    // The old snapshot and journal still hold everything; the next checkpoint tries again
+    if (!rotated) {
+        reportCheckpointError("Error: Unable to rotate the journal; the snapshot was not written.");
+        return;
     }
-    for (const auto& pair : users) {
-        pair.second->saveToFile(usersFile);
+    if (!Snapshot::writeImage(snapshotPath(), image)) {
+        reportCheckpointError("Error: Unable to write library snapshot.");
+        return;
     }
-    for (const auto& pair : accounts) {
-        pair.second.saveToFile(accountsFile);
+    lock_guard<mutex> journalGuard(journalMutex);
+    journal.dropRotated();
+}
+void Library::checkpointLoop() {
+    unique_lock<mutex> checkpointGuard(checkpointMutex);
+    while (true) {
+        checkpointWake.wait_for(checkpointGuard, chrono::seconds(CHECKPOINT_INTERVAL),
+                                [this] { return stopCheckpoints || checkpointRequested; });
+        if (stopCheckpoints) return;
+        checkpointRequested = false;
+        checkpointGuard.unlock();
+        bool pending;
+        {
+            lock_guard<mutex> journalGuard(journalMutex);
+            pending = journal.hasPendingEntries();
+        }
+        if (pending) saveData();
+        checkpointGuard.lock();
     }
-    booksFile.close();
-    usersFile.close();
-    accountsFile.close();
 }
+// Load the binary snapshot when it is at least as new as the text files,
+// otherwise import the text files (e.g. after they were edited by hand).
+// Journal entries newer than the loaded state are replayed on top of it.
 void Library::loadData() {
-    ifstream booksFile(dataDirectory + "/books.txt");
-    ifstream usersFile(dataDirectory + "/users.txt");
-    ifstream accountsFile(dataDirectory + "/accounts.txt");
-
-    if (!booksFile) cerr << "Warning: books.txt not found. Starting with empty library." << endl;
-    if (!usersFile) cerr << "Warning: users.txt not found. Starting with no users." << endl;
-    if (!accountsFile) cerr << "Warning: accounts.txt not found. Starting with no accounts." << endl;
-
-    // Load Books, Users, and Accounts
-    while (!booksFile.eof()) {
-        Book book = Book::loadFromFile(booksFile);
-        if (booksFile) books[book.getISBN()] = book;
-    }
-    while (!usersFile.eof()) {
-        User* user = User::loadFromFile(usersFile);
-        if (user) users[user->getId()] = user;
-    }
-    while (!accountsFile.eof()) {
-        Account account = Account::loadFromFile(accountsFile);
-        if (accountsFile) accounts[account.getUserId()] = account;
-    }
-    booksFile.close();
-    usersFile.close();
-    accountsFile.close();
-}   
+    OperationTimer timer(metrics, Operation::LoadData);
+    error_code ec;
+    string snapPath = snapshotPath();
+    bool useSnapshot = filesystem::exists(snapPath, ec);
+    if (useSnapshot) {
+        auto snapTime = filesystem::last_write_time(snapPath, ec);
+        for (const char* name : {"/books.txt", "/users.txt", "/accounts.txt", "/copies.txt", "/reservations.txt"}) {
+            string textPath = dataDirectory + name;
+            if (filesystem::exists(textPath, ec) && filesystem::last_write_time(textPath, ec) > snapTime)
+                useSnapshot = false;
+        }
+    }
+    uint64_t snapshotSeq = 0;
+    bool loaded = false;
+    if (useSnapshot) {
+        loaded = Snapshot::read(snapPath, bookIds, books, users, accounts, holdQueues, snapshotSeq);
+        if (!loaded)
+            cerr << "Warning: library.snap is invalid. Falling back to text files." << endl;
+    }
+    if (!loaded)
+        importTextData(dataDirectory);
+    rebuildIndexes();
+    replayJournal(snapshotSeq);
+    publishAll();
+}
+string Library::snapshotPath() const {
+    return dataDirectory + "/library.snap";
+}
+string Library::journalPath() const {
+    return dataDirectory + "/journal.log";
+}
+// Append an operation to the journal. Called while the locks protecting the
+// changed data are held, so entries touching the same book or account are
+// journaled in the order they were applied.
+void Library::logOperation(const vector<string>& fields) {
+    lock_guard<mutex> journalGuard(journalMutex);
+    if (!journal.append(fields))
+        cerr << "Warning: Unable to write to the journal." << endl;
+}
+void Library::logOperations(const vector<vector<string>>& entries) {
+    lock_guard<mutex> journalGuard(journalMutex);
+    if (!journal.appendAll(entries))
+        cerr << "Warning: Unable to write to the journal." << endl;
+}
+// Compact the journal into a snapshot once enough entries piled up; the
+// checkpoint thread does it, so the caller does not wait. Called by the
+// public operations after they released their locks.
+void Library::compactIfNeeded() {
+    {
+        lock_guard<mutex> journalGuard(journalMutex);
+        if (!journal.needsCompaction()) return;
+    }
+    {
+        lock_guard<mutex> checkpointGuard(checkpointMutex);
+        checkpointRequested = true;
+    }
+    checkpointWake.notify_one();
+}
+void Library::replayJournal(uint64_t snapshotSeq) {
+    vector<JournalEntry> entries = Journal::readEntries(journalPath());
+    uint64_t lastSeq = snapshotSeq;
+    for (const auto& entry : entries) {
+        if (entry.seq <= snapshotSeq) continue; // already part of the snapshot
+        if (!applyJournalEntry(entry))
+            cerr << "Warning: skipping invalid journal entry " << entry.seq << "." << endl;
+        lastSeq = max(lastSeq, entry.seq);
+    }
+    if (!journal.open(journalPath(), lastSeq, entries.size()))
+        cerr << "Warning: Unable to open the journal. Changes are saved only on exit." << endl;
+}
+// Apply one recorded operation without access checks or messages.
+bool Library::applyJournalEntry(const JournalEntry& entry) {
+    const vector<string>& f = entry.fields;
+    const string& op = f[0];
+    try {
+        if (op == "borrow" && (f.size() == 5 || f.size() == 6)) {
+            // borrow <userId> <ISBN> <borrowDate> <dueDate> [<copy>]; older entries are of the first copy
+            CopyId copy{0, f.size() == 6 ? static_cast<uint32_t>(stoul(f[5]) - 1) : 0};
+            Account* account = findAccount(stoi(f[1]));
+            if (!findBookId(f[2], copy.book) || !account) return false;
+            Book* book = bookById(copy.book);
+            if (!book || copy.copy >= book->getCopyCount()) return false;
+            BookCopy state = book->getCopy(copy.copy);
+            untrackLoan(copy, state);
+            state.setStatus(BookStatus::Borrowed);
+            state.setBorrowerId(stoi(f[1]));
+            state.setBorrowDate(static_cast<time_t>(stoll(f[3])));
+            state.setDueDate(static_cast<time_t>(stoll(f[4])));
+            book->setCopy(copy.copy, state);
+            trackLoan(copy, state);
+            account->addBorrowedBook(copy);
+            account->addToBorrowHistory(copy.book);
+        } else if (op == "return" && f.size() == 4) {
+            BookId id;
+            CopyId copy;
+            Account* account = findAccount(stoi(f[1]));
+            if (!findBookId(f[2], id) || !account || !account->findLoan(id, copy)) return false;
+            Book* book = bookById(id);
+            if (!book || copy.copy >= book->getCopyCount()) return false;
+            untrackLoan(copy, book->getCopy(copy.copy));
+            book->setCopy(copy.copy, BookCopy());
+            account->removeBorrowedBook(copy);
+            account->addToBorrowHistory(id);
+            if (stod(f[3]) > 0) account->addFine(stod(f[3]));
+        } else if (op == "put-book" && f.size() == 7) {
+            size_t copies = stoul(f[6]);
+            if (copies == 0 || !putBook(Book(f[1], f[2], f[3], stoi(f[4]), f[5], copies))) return false;
+        } else if (op == "put-book" && f.size() == 10) {
+            // Older entries with the state of the only copy; it applies to new books only
+            Book book(f[1], f[2], f[3], stoi(f[4]), f[5]);
+            BookCopy copy;
+            BookStatus status;
+            if (!bookStatusFromName(f[6], status)) return false;
+            copy.setStatus(status);
+            copy.setBorrowerId(stoi(f[7]));
+            copy.setBorrowDate(static_cast<time_t>(stoll(f[8])));
+            copy.setDueDate(static_cast<time_t>(stoll(f[9])));
+            book.setCopy(0, copy);
+            if (!putBook(book)) return false;
+        } else if (op == "remove-book" && f.size() == 2) {
+            BookId id;
+            if (findBookId(f[1], id)) eraseBook(id);
+        } else if (op == "put-user" && f.size() == 6) {
+            int id = stoi(f[2]);
+            UserRole role;
+            if (!userRoleFromName(f[1], role)) return false;
+            users.add(User(id, f[3], f[4], f[5], role));
+            accounts[id] = Account(id);
+        } else if (op == "remove-user" && f.size() == 2) {
+            users.erase(stoi(f[1]));
+            accounts.erase(stoi(f[1]));
+        } else if (op == "fine" && (f.size() == 3 || f.size() == 5)) {
+            // fine <userId> <amount>, or with the ledger: fine <userId> <ISBN> <amount> <accruedUntil>
+            Account* account = findAccount(stoi(f[1]));
+            if (!account) return false;
+            if (f.size() == 5) {
+                BookId id;
+                CopyId copy;
+                if (!findBookId(f[2], id) || !account->findLoan(id, copy)) return false;
+                account->setAccruedUntil(copy, static_cast<time_t>(stoll(f[4])));
+            }
+            account->addFine(stod(f.size() == 5 ? f[3] : f[2]));
+        } else if (op == "reserve" && f.size() == 3) {
+            BookId id;
+            if (!findBookId(f[2], id)) return false;
+            holdQueues[id].push_back(stoi(f[1]));
+        } else if (op == "cancel-reservation" && f.size() == 3) {
+            BookId id;
+            if (!findBookId(f[2], id)) return false;
+            auto queue = holdQueues.find(id);
+            if (queue == holdQueues.end()) return false;
+            auto pos = find(queue->second.begin(), queue->second.end(), stoi(f[1]));
+            if (pos == queue->second.end()) return false;
+            queue->second.erase(pos);
+            if (queue->second.empty()) holdQueues.erase(queue);
+        } else if (op == "hold" && (f.size() == 4 || f.size() == 5)) {
+            // hold <ISBN> <userId> <expiry> [<copy>]
+            CopyId copy{0, f.size() == 5 ? static_cast<uint32_t>(stoul(f[4]) - 1) : 0};
+            if (!findBookId(f[1], copy.book)) return false;
+            BookId id = copy.book;
+            int userId = stoi(f[2]);
+            // handOff() dropped the users in front of this one (removed users)
+            auto queue = holdQueues.find(id);
+            if (queue != holdQueues.end()) {
+                while (!queue->second.empty()) {
+                    int front = queue->second.front();
+                    queue->second.pop_front();
+                    if (front == userId) break;
+                }
+                if (queue->second.empty()) holdQueues.erase(queue);
+            }
+            Book* book = bookById(id);
+            if (!book || copy.copy >= book->getCopyCount()) return false;
+            BookCopy state;
+            untrackLoan(copy, book->getCopy(copy.copy));
+            state.setStatus(BookStatus::Reserved);
+            state.setBorrowerId(userId);
+            state.setDueDate(static_cast<time_t>(stoll(f[3])));
+            book->setCopy(copy.copy, state);
+            trackLoan(copy, state);
+        } else if (op == "release-hold" && (f.size() == 2 || f.size() == 3)) {
+            // release-hold <ISBN> [<copy>]
+            CopyId copy{0, f.size() == 3 ? static_cast<uint32_t>(stoul(f[2]) - 1) : 0};
+            if (!findBookId(f[1], copy.book)) return false;
+            Book* book = bookById(copy.book);
+            if (!book || copy.copy >= book->getCopyCount()) return false;
+            untrackLoan(copy, book->getCopy(copy.copy));
+            book->setCopy(copy.copy, BookCopy());
+        } else if (op == "settle-fines" && f.size() == 2) {
+            Account* account = findAccount(stoi(f[1]));
+            if (!account) return false;
+            account->payFines();
+        } else {
+            return false;
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    return true;
+}
+bool Library::importTextData(const string& dir) {
+    vector<string> errors;
+    TextLoader::load(dir, bookIds, books, users, accounts, holdQueues, errors);
+    const size_t shown = 20;
+    for (size_t i = 0; i < errors.size() && i < shown; ++i)
+        cerr << "Warning: " << errors[i] << endl;
+    if (errors.size() > shown)
+        cerr << "Warning: " << errors.size() - shown << " more problems in the text files." << endl;
+    return true;
+}
+// The export is also a checkpoint: the snapshot is written and the journal
+// rotated with the same state, so the journal only holds later operations once
+// the text files (which loadData then prefers) are written. As in saveData()
+// the books and users are rendered under the shared lock, and only the copies,
+// waitlists and accounts under the exclusive one; the files are then written
+// unlocked, each to <name>.tmp and renamed into place by replaceFile().
+// saveMutex is held until they are in place, so no checkpoint can rotate the
+// journal again before the text files are newer than the snapshot.
+bool Library::exportTextData(const string& dir) {
+    lock_guard<mutex> saveGuard(saveMutex);
+    SnapshotImage image;
+    ostringstream booksText, usersText, copiesText, reservationsText, accountsText;
+    while (true) {
+        uint64_t capturedChanges;
+        vector<BookId> ids;
+        {
+            shared_lock<shared_mutex> catalogLock(catalogMutex);
+            capturedChanges = catalogChanges;
+            image = Snapshot::captureCatalog(bookIds, books, users);
+            usersText.str("");
+            booksText.str("");
+            thread usersThread([&] {
+                for (const auto* entry : users.inKeyOrder()) entry->second->saveToFile(usersText);
+            });
+            for (const auto& pair : books) ids.push_back(pair.first);
+            sortByISBN(ids);
+            for (BookId id : ids) bookById(id)->saveToFile(booksText);
+            usersThread.join();
+        }
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        if (catalogChanges != capturedChanges) continue;
+        {
+            lock_guard<mutex> journalGuard(journalMutex);
+            Snapshot::captureLoans(image, books, accounts, holdQueues, journal.getLastSeq());
+            if (!journal.rotate()) {
+                cerr << "Error: Unable to rotate the journal; the text files were not written." << endl;
+                return false;
+            }
+        }
+        thread accountsThread([&] {
+            for (const auto* entry : accounts.inKeyOrder()) entry->second.saveToFile(accountsText, bookIds);
+        });
+        for (BookId id : ids) {
+            const Book* book = bookById(id);
+            for (uint32_t i = 0; i < book->getCopyCount(); ++i) {
+                const BookCopy& copy = book->getCopy(i);
+                if (copy.getStatus() == BookStatus::Available) continue;
+                copiesText << book->getISBN() << '\t' << i + 1 << '\t' << copy.getStatusName() << '\t'
+                           << copy.getBorrowerId() << '\t' << copy.getBorrowDate() << '\t' << copy.getDueDate() << '\n';
+            }
+            auto queue = holdQueues.find(id);
+            if (queue == holdQueues.end()) continue;
+            reservationsText << book->getISBN() << '\n' << queue->second.size() << '\n';
+            for (int userId : queue->second) reservationsText << userId << '\n';
+        }
+        accountsThread.join();
+        break;
+    }
+    if (!Snapshot::writeImage(snapshotPath(), image)) {
+        cerr << "Error: Unable to write library snapshot; the text files were not written." << endl;
+        return false;
+    }
+    {
+        lock_guard<mutex> journalGuard(journalMutex);
+        journal.dropRotated();
+    }
+    auto writeFile = [&dir](const string& name, const ostringstream& text) {
+        string path = dir + "/" + name;
+        {
+            ofstream outFile(path + ".tmp");
+            if (!outFile) return false;
+            string content = text.str();
+            outFile.write(content.data(), static_cast<streamsize>(content.size()));
+            if (!outFile) return false;
+        }
+        return replaceFile(path + ".tmp", path);
+    };
+    bool booksOk = true, usersOk = true, accountsOk = true;
+    thread booksThread([&] {
+        booksOk = writeFile("books.txt", booksText) && writeFile("copies.txt", copiesText) &&
+                  writeFile("reservations.txt", reservationsText);
+    });
+    thread usersThread([&] { usersOk = writeFile("users.txt", usersText); });
+    accountsOk = writeFile("accounts.txt", accountsText);
+    booksThread.join();
+    usersThread.join();
+    if (!booksOk || !usersOk || !accountsOk) {
+        cerr << "Error: Unable to write the text files." << endl;
+        return false;
+    }
+    return true;
+}
 // Utility: Get current time
 time_t Library::getCurrentDate() const {
     return time(nullptr);
@@ -102,88 +440,623 @@ int Library::calculateOverdueDays(time_t dueDate, time_t currentDate) const {
 
 // ----- Book Management -----
 
-void Library::addBook(const Book& book) {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
+// Insert or replace a book, keeping the search indexes in sync. The book is
+// stored under its canonical ISBN. A book already in the catalog keeps the
+// state of its copies and only takes over the details and the number of
+// copies. Returns false if the ISBN is invalid or copies that are out would
+// have to be dropped.
+bool Library::putBook(const Book& book) {
+    uint64_t key;
+    if (!parseISBN(book.getISBN(), key)) return false;
+    BookId id = bookIds.intern(key);
+    auto it = books.find(id);
+    if (it != books.end()) {
+        Book stored = it->second;
+        stored.setTitle(book.getTitle());
+        stored.setAuthor(book.getAuthor());
+        stored.setPublisher(book.getPublisher());
+        stored.setYear(book.getYear());
+        // Dropped copies are Available, so no loan or hold changes
+        if (!stored.setCopyCount(book.getCopyCount())) return false;
+        searchIndex.removeBook(id, it->second);
+        trigramIndex.removeBook(id, it->second);
+        catalogOrder.removeBook(id, it->second);
+        it->second = stored;
+    } else {
+        Book stored = book;
+        stored.setISBN(formatISBN(key));
+        it = books.emplace(id, stored).first;
+        for (uint32_t i = 0; i < stored.getCopyCount(); ++i)
+            trackLoan(CopyId{id, i}, stored.getCopy(i));
+    }
+    searchIndex.addBook(id, it->second);
+    trigramIndex.addBook(id, it->second);
+    catalogOrder.addBook(id, it->second);
+    publishCopies(id, it->second);
+    ++catalogChanges;
+    return true;
+}
+void Library::eraseBook(BookId id) {
+    auto it = books.find(id);
+    if (it == books.end()) return;
+    searchIndex.removeBook(id, it->second);
+    trigramIndex.removeBook(id, it->second);
+    catalogOrder.removeBook(id, it->second);
+    for (uint32_t i = 0; i < it->second.getCopyCount(); ++i)
+        untrackLoan(CopyId{id, i}, it->second.getCopy(i));
+    books.erase(it);
+    versions.erase(id);
+    ++catalogChanges;
+    lock_guard<mutex> dueGuard(dueMutex);
+    holdQueues.erase(id);
+}
+void Library::rebuildIndexes() {
+    searchIndex.build(books);
+    trigramIndex.build(books);
+    catalogOrder.build();
+    dueIndex.clear();
+    holdIndex.clear();
+    for (const auto& pair : books) {
+        for (uint32_t i = 0; i < pair.second.getCopyCount(); ++i)
+            trackLoan(CopyId{pair.first, i}, pair.second.getCopy(i));
+    }
+}
+// Keep dueIndex and holdIndex in sync; call trackLoan after a copy is
+// borrowed or reserved and untrackLoan before that ends (while its due date
+// or hold expiry is still set).
+void Library::trackLoan(CopyId copy, const BookCopy& state) {
+    if (state.getStatus() == BookStatus::Available) return;
+    lock_guard<mutex> dueGuard(dueMutex);
+    (state.getStatus() == BookStatus::Borrowed ? dueIndex : holdIndex).insert({state.getDueDate(), copy});
+}
+void Library::untrackLoan(CopyId copy, const BookCopy& state) {
+    if (state.getStatus() == BookStatus::Available) return;
+    lock_guard<mutex> dueGuard(dueMutex);
+    (state.getStatus() == BookStatus::Borrowed ? dueIndex : holdIndex).erase({state.getDueDate(), copy});
+}
+bool Library::findBookId(const string& ISBN, BookId& id) const {
+    uint64_t key;
+    return parseISBN(ISBN, key) && bookIds.find(key, id) && books.count(id);
+}
+Book* Library::bookById(BookId id) {
+    auto it = books.find(id);
+    return it != books.end() ? &it->second : nullptr;
+}
+const Book* Library::bookById(BookId id) const {
+    auto it = books.find(id);
+    return it != books.end() ? &it->second : nullptr;
+}
+// Listings show books in ISBN order, whatever order their IDs were assigned in
+void Library::sortByISBN(vector<BookId>& ids) const {
+    sort(ids.begin(), ids.end(),
+         [this](BookId a, BookId b) { return bookIds.getKey(a) < bookIds.getKey(b); });
+}
+// Copy of the loans that are at least one day overdue, most overdue first.
+// Given after, only those that follow it in dueIndex, and at most limit, so
+// long lists can be walked in batches without holding dueMutex throughout.
+vector<pair<time_t, CopyId>> Library::overdueLoans(time_t currentDate, const pair<time_t, CopyId>* after,
+                                                   size_t limit) const {
+    vector<pair<time_t, CopyId>> overdue;
+    lock_guard<mutex> dueGuard(dueMutex);
+    for (auto it = after ? dueIndex.upper_bound(*after) : dueIndex.begin();
+         it != dueIndex.end() && overdue.size() < limit; ++it) {
+        if (calculateOverdueDays(it->first, currentDate) <= 0) break;
+        overdue.push_back(*it);
+    }
+    return overdue;
+}
+
+// Charge an overdue loan at fineRate for the days not charged yet and record
+// the time in the account's fine ledger. Running it again the same day charges
+// nothing. Caller holds the account stripe and the book's stripe.
+int Library::accrueFine(int userId, Account& account, CopyId copy, const Book& book, int fineRate,
+                        time_t currentDate) {
+    time_t dueDate = book.getCopy(copy.copy).getDueDate();
+    time_t accruedUntil = account.getAccruedUntil(copy);
+    int charged = accruedUntil != 0 ? calculateOverdueDays(dueDate, accruedUntil) : 0;
+    int days = calculateOverdueDays(dueDate, currentDate) - charged;
+    if (days <= 0) return 0;
+    int fine = days * fineRate;
+    account.addFine(fine);
+    account.setAccruedUntil(copy, currentDate);
+    logOperation({"fine", to_string(userId), book.getISBN(), to_string(fine), to_string(currentDate)});
+    return fine;
+}
+
+// ----- Locking -----
+
+mutex& Library::accountLock(int userId) const {
+    return accountLocks[static_cast<unsigned>(userId) % LOCK_STRIPES];
+}
+mutex& Library::bookLock(BookId id) const {
+    return bookLocks[id % LOCK_STRIPES];
+}
+// Lock the stripes of several books in ascending stripe order
+vector<unique_lock<mutex>> Library::lockBooks(vector<BookId> ids) const {
+    for (auto& id : ids) id %= LOCK_STRIPES;
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    vector<unique_lock<mutex>> guards;
+    for (BookId stripe : ids)
+        guards.emplace_back(bookLocks[stripe]);
+    return guards;
+}
+// ----- Snapshot reads -----
+
+// Called after every change to a book's copies, under the book's stripe (or
+// the exclusive catalog lock), once the operation has made all its changes
+void Library::publishCopies(BookId id, const Book& book) {
+    versions.publish(id, book.getCopies());
+}
+// After loading, when no reader can be active
+void Library::publishAll() {
+    versions.clear();
+    for (const auto& pair : books) publishCopies(pair.first, pair.second);
+}
+// A book as of view. The details are read from books, which is safe without
+// the stripe since they only change under the exclusive catalog lock; the
+// copies come from the book's version. Caller holds catalogMutex shared.
+Book Library::viewCopy(const CatalogVersions::View& view, BookId id, const Book& book) const {
+    Book copy(book.getTitle(), book.getAuthor(), book.getPublisher(), book.getYear(), book.getISBN(), 0);
+    if (auto version = view.find(id)) copy.setCopies(version->copies);
+    return copy;
+}
+
+// Journal record holding the details of a book and its number of copies
+static vector<string> bookRecordFields(const Book& book) {
+    return {"put-book", book.getTitle(), book.getAuthor(), book.getPublisher(), to_string(book.getYear()),
+            book.getISBN(), to_string(book.getCopyCount())};
+}
+
+bool Library::addBook(const Book& book) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
         cout << "Access denied. Only librarians can add books.\n";
-        return;
+        return false;
+    }
+    uint64_t key;
+    if (!parseISBN(book.getISBN(), key)) {
+        cout << "Invalid ISBN: " << book.getISBN() << "\n";
+        return false;
+    }
+    if (book.getCopyCount() == 0) {
+        cout << "A book needs at least one copy.\n";
+        return false;
     }
-    books[book.getISBN()] = book;
-    cout << "Book added successfully.\n";
+    Book stored = book;
+    stored.setISBN(formatISBN(key));
+    size_t copyCount;
+    uint32_t held = 0;
+    bool existed;
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        // A book that is already cataloged gets the new copies added to it
+        existed = findBookId(stored.getISBN(), id);
+        if (existed) {
+            uint32_t firstNew = bookById(id)->getCopyCount();
+            stored = *bookById(id);
+            stored.setCopyCount(stored.getCopyCount() + book.getCopyCount());
+            putBook(stored);
+            logOperation(bookRecordFields(stored));
+            held = handOffNewCopies(id, firstNew);
+        } else {
+            putBook(stored);
+            logOperation(bookRecordFields(stored));
+        }
+        copyCount = stored.getCopyCount();
+    }
+    compactIfNeeded();
+    if (existed)
+        cout << "Book already in the catalog; added " << book.getCopyCount()
+             << (book.getCopyCount() == 1 ? " copy" : " copies") << ", it now has " << copyCount << ".\n";
+    else
+        cout << "Book added successfully.\n";
+    if (held > 0) cout << held << (held == 1 ? " copy is" : " copies are") << " now held for users on the waitlist.\n";
+    return true;
 }
 
-void Library::removeBook(const string& ISBN) {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
+bool Library::removeBook(const string& ISBN) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
         cout << "Access denied. Only librarians can remove books.\n";
-        return;
+        return false;
+    }
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(ISBN, id)) {
+            cout << "Book not found.\n";
+            return false;
+        }
+        logOperation({"remove-book", bookIds.getISBN(id)});
+        eraseBook(id);
     }
-    books.erase(ISBN);
+    compactIfNeeded();
     cout << "Book removed successfully.\n";
+    return true;
 }
-void Library::updateBook(const Book& book) {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
-        cout << "Access denied. Only librarians can add books.\n";
-        return;
+bool Library::updateBook(const Book& book) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
+        cout << "Access denied. Only librarians can update books.\n";
+        return false;
+    }
+    uint64_t key;
+    if (!parseISBN(book.getISBN(), key)) {
+        cout << "Invalid ISBN: " << book.getISBN() << "\n";
+        return false;
+    }
+    Book stored = book;
+    stored.setISBN(formatISBN(key));
+    uint32_t held = 0;
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(stored.getISBN(), id)) {
+            cout << "Book not found.\n";
+            return false;
+        }
+        uint32_t firstNew = bookById(id)->getCopyCount();
+        if (book.getCopyCount() == 0 || !putBook(stored)) {
+            cout << "Only copies that are available can be removed, and a book keeps at least one.\n";
+            return false;
+        }
+        logOperation(bookRecordFields(stored));
+        held = handOffNewCopies(id, firstNew);
     }
-    books[book.getISBN()] = book;
+    compactIfNeeded();
     cout << "Book updated successfully.\n";
+    if (held > 0) cout << held << (held == 1 ? " copy is" : " copies are") << " now held for users on the waitlist.\n";
+    return true;
 }
 
+// Page through the catalog until the user presses Enter on an empty line
 void Library::displayAllBooks() const {
-    for (const auto& pair : books)
-        pair.second.displayDetails();
+    const size_t pageSize = 20;
+    BookOrder order = BookOrder::ISBN;
+    size_t offset = 0;
+    string input;
+    while (true) {
+        BookPage page = listBooks(order, offset, pageSize);
+        displayBookPage(page);
+        cout << "[n]ext, [p]revious, sort by [i]SBN, [t]itle, [a]uthor, pu[b]lisher, [y]ear or [d]ue date, "
+                "Enter to go back: ";
+        if (!getline(cin, input) || input.empty()) break;
+        switch (tolower(static_cast<unsigned char>(input[0]))) {
+            case 'n': if (offset + pageSize < page.total) offset += pageSize; break;
+            case 'p': offset = offset >= pageSize ? offset - pageSize : 0; break;
+            case 'i': order = BookOrder::ISBN; offset = 0; break;
+            case 't': order = BookOrder::Title; offset = 0; break;
+            case 'a': order = BookOrder::Author; offset = 0; break;
+            case 'b': order = BookOrder::Publisher; offset = 0; break;
+            case 'y': order = BookOrder::Year; offset = 0; break;
+            case 'd': order = BookOrder::DueDate; offset = 0; break;
+        }
+    }
+}
+// Copies of the books at [offset, offset + limit) of the listing. The sorted
+// orders are kept by catalogOrder; the due-date order is the loan index, with
+// one entry per borrowed copy.
+BookPage Library::listBooks(BookOrder order, size_t offset, size_t limit) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    BookPage page{order, offset, 0, {}};
+    vector<BookId> ids;
+    CatalogVersions::View view(versions);
+    if (order == BookOrder::DueDate) {
+        lock_guard<mutex> dueGuard(dueMutex);
+        page.total = dueIndex.size();
+        auto it = dueIndex.begin();
+        for (size_t i = 0; i < offset && it != dueIndex.end(); ++i) ++it;
+        for (; it != dueIndex.end() && ids.size() < limit; ++it) ids.push_back(it->second.book);
+    } else {
+        const vector<BookId>& sorted = catalogOrder.ids(order);
+        page.total = sorted.size();
+        for (size_t i = offset; i < sorted.size() && ids.size() < limit; ++i) ids.push_back(sorted[i]);
+    }
+    page.books.reserve(ids.size());
+    for (BookId id : ids) page.books.push_back(viewCopy(view, id, *bookById(id)));
+    return page;
 }
+// The secondary index lookups binary-search the sorted orders of catalogOrder.
+// Caller holds catalogMutex shared.
+vector<Book> Library::copyRange(BookOrder order, pair<size_t, size_t> range) const {
+    CatalogVersions::View view(versions);
+    vector<Book> found;
+    found.reserve(range.second - range.first);
+    for (size_t i = range.first; i < range.second; ++i) {
+        BookId id = catalogOrder.ids(order)[i];
+        found.push_back(viewCopy(view, id, *bookById(id)));
+    }
+    return found;
+}
+vector<Book> Library::booksByAuthor(const string& author) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    return copyRange(BookOrder::Author, catalogOrder.equalRange(BookOrder::Author, author));
+}
+vector<Book> Library::booksByPublisher(const string& publisher) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    return copyRange(BookOrder::Publisher, catalogOrder.equalRange(BookOrder::Publisher, publisher));
+}
+vector<Book> Library::booksByYear(int fromYear, int toYear) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    return copyRange(BookOrder::Year, catalogOrder.yearRange(fromYear, toYear));
+}
+// Search prompt of the menus: a keyword, or "author:<name>",
+// "publisher:<name>" or "year:<from>-<to>" for the secondary indexes
+void Library::displaySearchResults(const string& query) const {
+    auto show = [](const vector<Book>& found) {
+        string text;
+        for (const Book& book : found) book.appendDetails(text);
+        if (found.empty()) text = "No books found.\n";
+        cout << text;
+    };
+    auto value = [&query](size_t prefixLength) {
+        size_t start = query.find_first_not_of(' ', prefixLength);
+        return start == string::npos ? string() : query.substr(start);
+    };
+    if (query.compare(0, 6, "words:") == 0) {
+        searchBooksByWords(value(6));
+    } else if (query.compare(0, 7, "author:") == 0) {
+        show(booksByAuthor(value(7)));
+    } else if (query.compare(0, 10, "publisher:") == 0) {
+        show(booksByPublisher(value(10)));
+    } else if (query.compare(0, 5, "year:") == 0) {
+        int fromYear = 0, toYear = 0;
+        char dash = '-';
+        istringstream iss(value(5));
+        if (!(iss >> fromYear)) {
+            cout << "Please give a year or a range like year:1995-2005.\n";
+            return;
+        }
+        toYear = (iss >> dash >> toYear && dash == '-') ? toYear : fromYear;
+        show(booksByYear(fromYear, toYear));
+    } else {
+        searchBooks(query);
+    }
+}
+// Render a page into one buffer and write it with a single call
+void Library::displayBookPage(const BookPage& page) {
+    string text;
+    if (page.books.empty()) {
+        text = page.total == 0 ? "No books.\n" : "No books on this page.\n";
+    } else {
+        text = "Books " + to_string(page.offset + 1) + "-" + to_string(page.offset + page.books.size()) +
+               " of " + to_string(page.total) + ", sorted by " + bookOrderName(page.order) + ":\n\n";
+        for (const Book& book : page.books) book.appendDetails(text);
+    }
+    cout.write(text.data(), static_cast<streamsize>(text.size()));
+    cout.flush();
+}
+// Case-sensitive substring match on title, author or ISBN. Keywords of three
+// or more characters are narrowed through the trigram index first; the
+// candidates are then checked exactly like a full scan would.
 void Library::searchBooks(const string& keyword) const {
-    for (const auto& pair : books) {
-        if (pair.second.getTitle().find(keyword) != string::npos ||
-            pair.second.getAuthor().find(keyword) != string::npos ||
-            pair.second.getISBN().find(keyword) != string::npos) {
-            pair.second.displayDetails();
+    OperationTimer timer(metrics, Operation::Search);
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    auto matches = [&keyword](const Book& book) {
+        return book.getTitle().find(keyword) != string::npos ||
+               book.getAuthor().find(keyword) != string::npos ||
+               book.getISBN().find(keyword) != string::npos;
+    };
+    vector<BookId> found;
+    if (keyword.size() < 3) {
+        for (const auto& pair : books) {
+            if (matches(pair.second)) found.push_back(pair.first);
+        }
+    } else {
+        for (BookId id : trigramIndex.candidates(keyword)) {
+            const Book* book = bookById(id);
+            if (book && matches(*book)) found.push_back(id);
         }
     }
+    sortByISBN(found);
+    CatalogVersions::View view(versions);
+    string text;
+    for (BookId id : found) viewCopy(view, id, *bookById(id)).appendDetails(text);
+    if (text.empty()) text = "No books found.\n";
+    cout << text;
+}
+// Every word must appear (case-insensitively) as a word of the title,
+// author or ISBN.
+void Library::searchBooksByWords(const string& words) const {
+    OperationTimer timer(metrics, Operation::Search);
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    vector<BookId> found = searchIndex.query(TokenIndex::tokenize(words));
+    sortByISBN(found);
+    CatalogVersions::View view(versions);
+    string text;
+    for (BookId id : found) {
+        if (const Book* book = bookById(id))
+            viewCopy(view, id, *book).appendDetails(text);
+    }
+    if (text.empty()) text = "No books found.\n";
+    cout << text;
+}
+
+// ----- Bulk import -----
+// Rejection found while inserting, after TextLoader parsed the file
+template <typename T>
+static void rejectRow(CsvRows<T>& parsed, const string& path, size_t line, const string& problem) {
+    ++parsed.rejected;
+    if (parsed.errors.size() < 1000)
+        parsed.errors.push_back(filesystem::path(path).filename().string() + ":" + to_string(line) + ": " + problem);
+}
+template <typename T>
+static void reportImport(const CsvRows<T>& parsed, size_t added, const char* what,
+                         chrono::steady_clock::time_point start) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << "Imported " << added << " " << what << " from " << parsed.read << " rows in " << fixed
+         << setprecision(3) << seconds << " s (" << setprecision(0)
+         << (seconds > 0 ? parsed.read / seconds : 0.0) << " rows/s), " << parsed.rejected << " rejected.\n";
+    cout.flags(flags);
+    cout.precision(precision);
+    const size_t shown = 20;
+    for (size_t i = 0; i < parsed.errors.size() && i < shown; ++i)
+        cout << "Rejected " << parsed.errors[i] << "\n";
+    if (parsed.rejected > shown)
+        cout << parsed.rejected - shown << " more rows rejected.\n";
+}
+
+// Large imports rebuild the search indexes once instead of adding the books
+// one at a time; the orders always take the new books in one merge
+bool Library::importBooksCsv(const string& path) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
+        cout << "Access denied. Only librarians can import books.\n";
+        return false;
+    }
+    auto start = chrono::steady_clock::now();
+    CsvRows<CsvBook> parsed;
+    if (!TextLoader::loadBookCsv(path, parsed)) {
+        cout << "Unable to read " << path << ".\n";
+        return false;
+    }
+    size_t added = 0;
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        bool rebuild = parsed.rows.size() > books.size() / 16;
+        books.reserve(books.size() + parsed.rows.size());
+        vector<vector<string>> entries;
+        entries.reserve(parsed.rows.size());
+        vector<BookId> addedIds;
+        addedIds.reserve(parsed.rows.size());
+        for (CsvBook& row : parsed.rows) {
+            BookId id;
+            if (bookIds.find(row.key, id) && books.count(id)) {
+                rejectRow(parsed, path, row.line, "ISBN " + row.book.getISBN() + " is already in the catalog");
+                continue;
+            }
+            id = bookIds.intern(row.key);
+            const Book& book = books.emplace(id, move(row.book)).first->second;
+            if (!rebuild) {
+                searchIndex.addBook(id, book);
+                trigramIndex.addBook(id, book);
+            }
+            publishCopies(id, book);
+            entries.push_back(bookRecordFields(book));
+            addedIds.push_back(id);
+            ++added;
+        }
+        catalogOrder.addBooks(move(addedIds));
+        if (rebuild && added > 0) {
+            searchIndex.build(books);
+            trigramIndex.build(books);
+        }
+        if (added > 0) {
+            ++catalogChanges;
+            logOperations(entries);
+        }
+    }
+    compactIfNeeded();
+    reportImport(parsed, added, "books", start);
+    return true;
+}
+bool Library::importUsersCsv(const string& path) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
+        cout << "Access denied. Only librarians can import users.\n";
+        return false;
+    }
+    auto start = chrono::steady_clock::now();
+    CsvRows<CsvUser> parsed;
+    if (!TextLoader::loadUserCsv(path, parsed)) {
+        cout << "Unable to read " << path << ".\n";
+        return false;
+    }
+    size_t added = 0;
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        users.reserve(users.size() + parsed.rows.size());
+        accounts.reserve(accounts.size() + parsed.rows.size());
+        vector<vector<string>> entries;
+        entries.reserve(parsed.rows.size());
+        for (CsvUser& row : parsed.rows) {
+            const User& user = row.user;
+            if (findUser(user.getId())) {
+                rejectRow(parsed, path, row.line, "user ID " + to_string(user.getId()) + " already exists");
+                continue;
+            }
+            entries.push_back({"put-user", user.getRoleName(), to_string(user.getId()), user.getName(),
+                               user.getEmail(), user.getPassword()});
+            accounts[user.getId()] = Account(user.getId());
+            users.add(move(row.user));
+            ++added;
+        }
+        if (added > 0) {
+            ++catalogChanges;
+            logOperations(entries);
+        }
+    }
+    compactIfNeeded();
+    reportImport(parsed, added, "users", start);
+    return true;
 }
 
 // ----- User Management -----
-void Library::addUser(User* user) {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
+bool Library::addUser(const User& user) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
         cout << "Access denied. Only librarians can add users.\n";
-        return;
+        return false;
     }
 
     int librarianId = currentUserId; // Store the current librarian's ID
 
-    users[user->getId()] = user;
-    accounts[user->getId()] = Account(user->getId());
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        if (findUser(user.getId())) {
+            cout << "A user with ID " << user.getId() << " already exists.\n";
+            return false;
+        }
+        users.add(user);
+        accounts[user.getId()] = Account(user.getId());
+        ++catalogChanges;
+        logOperation({"put-user", user.getRoleName(), to_string(user.getId()), user.getName(),
+                      user.getEmail(), user.getPassword()});
+    }
+    compactIfNeeded();
     cout << "User added successfully.\n";
 
     currentUserId = librarianId; // Restore the librarian's ID
+    return true;
 }
-void Library::removeUser(int userId) {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
+bool Library::removeUser(int userId) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
         cout << "Access denied. Only librarians can remove users.\n";
-        return;
+        return false;
     }    
-    users.erase(userId);
-    accounts.erase(userId);
+    {
+        unique_lock<shared_mutex> catalogLock(catalogMutex);
+        if (!findUser(userId)) {
+            cout << "User not found.\n";
+            return false;
+        }
+        users.erase(userId);
+        accounts.erase(userId);
+        ++catalogChanges;
+        logOperation({"remove-user", to_string(userId)});
+    }
+    compactIfNeeded();
     cout << "User removed successfully.\n";
+    return true;
 }
 void Library::displayAllUsers() const {
-    if (!isLoggedIn() || getCurrentUser()->getRole() != "Librarian") {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
         cout << "Access denied. Only librarians can display users.\n";
         return;
     }
-    for (const auto& pair : users)
-        pair.second->displayDetails();
+    for (const auto* entry : users.inKeyOrder())
+        entry->second->displayDetails();
 }
 
 User* Library::findUser(int userId) const { 
-    auto it = users.find(userId);
-    return (it != users.end()) ? it->second : nullptr;
+    return users.find(userId);
 }
 Book* Library::findBook(const string& ISBN) {
-    auto it = books.find(ISBN);
-    if (it != books.end())
-        return &(it->second);
-    return nullptr;
+    uint64_t key;
+    BookId id;
+    if (!parseISBN(ISBN, key) || !bookIds.find(key, id)) return nullptr;
+    return bookById(id);
+}
+const Book* Library::findBook(const string& ISBN) const {
+    return const_cast<Library*>(this)->findBook(ISBN);
 }
 Account* Library::findAccount(int userId) {
     auto it = accounts.find(userId);
@@ -209,59 +1082,121 @@ Account* Library::findAccount(int userId) {
 */
 
 bool Library::borrowBook(int userId, const string& ISBN) {
+    OperationTimer timer(metrics, Operation::Borrow);
+    expireHolds();
+    bool borrowed;
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(ISBN, id)) {
+            cerr << "Invalid user or book." << endl;
+            return timer.finish(false);
+        }
+        borrowed = doBorrowBook(userId, id);
+    }
+    if (borrowed) compactIfNeeded();
+    return timer.finish(borrowed);
+}
+// Caller holds catalogMutex shared
+bool Library::doBorrowBook(int userId, BookId id) {
     User* user = findUser(userId);
-    Book* book = findBook(ISBN);
+    Book* book = bookById(id);
     Account* account = findAccount(userId);
     // Trivial errors : Invalid user or book, book not available, librarian borrowing.
     if (!user || !book || !account) {
         cerr << "Invalid user or book." << endl;
         return false;
     }
-    if (book->getStatus() != "Available") {
-        cout << "Book is not available for borrowing." << endl;
+    // The account's current loans are read for the faculty overdue check, so
+    // their books are locked together with the requested one.
+    lock_guard<mutex> accountGuard(accountLock(userId));
+    vector<BookId> lockedBooks;
+    for (CopyId loan : account->getBorrowedBooks()) lockedBooks.push_back(loan.book);
+    lockedBooks.push_back(id);
+    vector<unique_lock<mutex>> bookGuards = lockBooks(move(lockedBooks));
+    CopyId loan;
+    if (account->findLoan(id, loan)) {
+        cout << "You have already borrowed this book." << endl;
         return false;
     }
-    if(user->getRole() == "Librarian") {
-        cout << "Librarians cannot borrow books." << endl;
+    // A copy held for the user is picked up, otherwise the free list gives an
+    // Available copy. Copies reserved for other users are never lent.
+    uint32_t copy = 0;
+    bool pickup = findHeldCopy(*book, userId, copy);
+    if (!pickup && !book->findFreeCopy(copy)) {
+        if (book->getCopy(0).getStatus() == BookStatus::Reserved && book->getCopyCount() == 1)
+            cout << "Book is reserved for another user." << endl;
+        else
+            cout << "Book is not available for borrowing." << endl;
         return false;
     }
-    else if (user->getRole() == "Faculty") {
-        if(account->getBorrowedBooks().size() >= static_cast<size_t>(Faculty::getMaxBooks())) {
-            cout << "Faculty members can borrow only " << Faculty::getMaxBooks() << " books at a time." << endl;
-            return false;
-        }
-        // Check if faculty has overdue books
-        for (const string& borrowedISBN : account->getBorrowedBooks()) {
-            Book* borrowedBook = findBook(borrowedISBN);
-            if (borrowedBook && calculateOverdueDays(borrowedBook->getDueDate(), getCurrentDate()) > Faculty::getMaxOverdueDays()) {
-                cout << "Faculty members cannot borrow new books if they have overdue books for more than " << Faculty::getMaxOverdueDays() << " days." << endl;
+    const RolePolicy& policy = rolePolicy(user->getRole());
+    if (policy.maxBooks == 0) {
+        cout << policy.plural << " cannot borrow books." << endl;
+        return false;
+    }
+    if (account->getBorrowedBooks().size() >= static_cast<size_t>(policy.maxBooks)) {
+        cout << policy.plural << " can borrow only " << policy.maxBooks << (policy.maxBooks == 1 ? " book" : " books")
+             << " at a time." << endl;
+        return false;
+    }
+    if (policy.maxOverdueDays >= 0) {
+        // Check if the user has books overdue for too long
+        for (CopyId borrowed : account->getBorrowedBooks()) {
+            Book* borrowedBook = bookById(borrowed.book);
+            if (borrowedBook && calculateOverdueDays(borrowedBook->getCopy(borrowed.copy).getDueDate(), getCurrentDate()) > policy.maxOverdueDays) {
+                cout << policy.plural << " cannot borrow new books if they have overdue books for more than " << policy.maxOverdueDays << " days." << endl;
                 return false;
             }
         }
     }
-    else if(user->getRole() == "Student") {
-        if(account->getBorrowedBooks().size() >= static_cast<size_t>(Student::getMaxBooks())) {
-            cout << "Students can borrow only " << Student::getMaxBooks() << " books at a time." << endl;
-            return false;
+    if (policy.fineRate > 0) {
+        // Bring the fines of the current loans up to date first
+        time_t now = getCurrentDate();
+        for (CopyId borrowed : account->getBorrowedBooks()) {
+            if (const Book* borrowedBook = bookById(borrowed.book))
+                accrueFine(userId, *account, borrowed, *borrowedBook, policy.fineRate, now);
         }
         if (account->getFines() > 0) {
             cout << "Please clear your outstanding fines before borrowing new books." << endl;
             return false;
         }
     }
-    else {
-        cerr << "Invalid user role." << endl;
-        return false;
-    }
 
-    // Borrow the book (using polymorphism)
+    // Borrow the copy by the rules of the user's role
     time_t currentDate = getCurrentDate();
-    if (user->borrowBook(*book, currentDate)) {
-        account->addBorrowedBook(ISBN);
-        account->addToBorrowHistory(ISBN);
+    loan = CopyId{id, copy};
+    BookCopy state = book->getCopy(copy);
+    if (pickup) {
+        untrackLoan(loan, state); // leaves the hold index
+        state = BookCopy();
+    }
+    if (user->borrowBook(state, currentDate)) {
+        book->setCopy(copy, state);
+        publishCopies(id, *book);
+        trackLoan(loan, state);
+        account->addBorrowedBook(loan);
+        account->addToBorrowHistory(id);
+        logOperation({"borrow", to_string(userId), book->getISBN(), to_string(state.getBorrowDate()),
+                      to_string(state.getDueDate()), to_string(copy + 1)});
+        if (!pickup) {
+            // A user who was waiting and got a free copy leaves the waitlist
+            lock_guard<mutex> dueGuard(dueMutex);
+            auto queue = holdQueues.find(id);
+            if (queue != holdQueues.end()) {
+                auto pos = find(queue->second.begin(), queue->second.end(), userId);
+                if (pos != queue->second.end()) {
+                    queue->second.erase(pos);
+                    if (queue->second.empty()) holdQueues.erase(queue);
+                    logOperation({"cancel-reservation", to_string(userId), book->getISBN()});
+                }
+            }
+        }
         cout << "Book borrowed successfully." << endl;
+        if (book->getCopyCount() > 1) cout << "Copy " << copy + 1 << " of " << book->getCopyCount() << "." << endl;
         return true;
     }
+    if (pickup) trackLoan(loan, book->getCopy(copy)); // still held
     return false;
 }
 /*
@@ -291,89 +1226,530 @@ bool Library::borrowBook(int userId, const string& ISBN) {
       returned.
 */
 bool Library::returnBook(int userId, const string& ISBN) {
+    OperationTimer timer(metrics, Operation::Return);
+    bool returned;
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(ISBN, id)) {
+            cerr << "Invalid user or book." << endl;
+            return timer.finish(false);
+        }
+        returned = doReturnBook(userId, id);
+    }
+    if (returned) compactIfNeeded();
+    return timer.finish(returned);
+}
+// Caller holds catalogMutex shared
+bool Library::doReturnBook(int userId, BookId id) {
     User* user = findUser(userId);
-    Book* book = findBook(ISBN);
+    Book* book = bookById(id);
     Account* account = findAccount(userId);
     if (!user || !book || !account) {
         cerr << "Invalid user or book." << endl;
         return false;
     }
+    lock_guard<mutex> accountGuard(accountLock(userId));
+    lock_guard<mutex> bookGuard(bookLock(id));
+    CopyId loan;
+    if (!account->findLoan(id, loan) || loan.copy >= book->getCopyCount() ||
+        book->getCopy(loan.copy).getStatus() != BookStatus::Borrowed ||
+        book->getCopy(loan.copy).getBorrowerId() != userId) {
+        cout << "This book was not borrowed by you." << endl;
+        return false;
+    }
     time_t currentDate = getCurrentDate();
-    bool fineApplicable = user->returnBook(*book, currentDate);
-    account->removeBorrowedBook(ISBN);
-    account->addToBorrowHistory(ISBN);
-    book->setStatus("Available");
+    BookCopy state = book->getCopy(loan.copy);
+    time_t dueDate = state.getDueDate(); // returnBook() clears it
+    time_t accruedUntil = account->getAccruedUntil(loan); // removeBorrowedBook() drops it
+    untrackLoan(loan, state);
+    bool fineApplicable = user->returnBook(state, currentDate);
+    book->setCopy(loan.copy, state);
+    account->removeBorrowedBook(loan);
+    account->addToBorrowHistory(id);
     
+    int fine = 0;
     if (fineApplicable) {
-        int overdueDays = calculateOverdueDays(book->getDueDate(), currentDate);
-        if (overdueDays > 0 && user->getRole() == "Student") {
-            int fine = overdueDays * Student::getFineRate();
-            account->addFine(fine);
-            cout << "Book returned. Overdue by " << overdueDays 
-                      << " days. Fine: Rs." << fine << endl;
+        int overdueDays = calculateOverdueDays(dueDate, currentDate);
+        int fineRate = rolePolicy(user->getRole()).fineRate;
+        if (overdueDays > 0 && fineRate > 0) {
+            // Days already charged through the fine ledger are not charged again
+            int charged = accruedUntil != 0 ? calculateOverdueDays(dueDate, accruedUntil) : 0;
+            fine = max(0, overdueDays - charged) * fineRate;
+            if (fine > 0) account->addFine(fine);
+            cout << "Book returned. Overdue by " << overdueDays << " days. Fine: Rs." << fine;
+            if (charged > 0) cout << " (Rs." << charged * fineRate << " was already charged)";
+            cout << endl;
         } else {
             cout << "Book returned successfully." << endl;
         }
     } else {
         cout << "Book returned successfully." << endl;
     }
+    logOperation({"return", to_string(userId), book->getISBN(), to_string(fine)});
+    handOff(loan, *book, currentDate);
+    publishCopies(id, *book); // the return and the hand-off are one commit
+    if (book->getCopy(loan.copy).getStatus() == BookStatus::Reserved)
+        cout << "The book is now held for the next user on its waitlist." << endl;
     return true;
 }
+// Both walk dueIndex from the earliest due date and stop at the first loan
+// that is not overdue yet, so only overdue loans are visited.
 void Library::checkOverdueBooks() {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
     time_t currentDate = getCurrentDate();
-    for (auto& pair : books) {
-        Book& book = pair.second;
-        if (book.getStatus() == "Borrowed") {
-            int overdueDays = calculateOverdueDays(book.getDueDate(), currentDate);
-            if (overdueDays > 0) {
-                cout << "Book \"" << book.getTitle() << "\" is overdue by " 
-                          << overdueDays << " days." << endl;
-            }
+    for (const auto& entry : overdueLoans(currentDate)) {
+        const Book* book = bookById(entry.second.book);
+        if (book) {
+            cout << "Book \"" << book->getTitle() << "\"";
+            if (book->getCopyCount() > 1) cout << " (copy " << entry.second.copy + 1 << ")";
+            cout << " is overdue by " << calculateOverdueDays(entry.first, currentDate) << " days." << endl;
         }
     }
 }
+// Charges every overdue student loan for the days since its ledger entry, so
+// it can run as often as wanted; only the loans in dueIndex that are overdue are visited.
 void Library::calculateFines() {
+    OperationTimer timer(metrics, Operation::CalculateFines);
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        time_t currentDate = getCurrentDate();
+        for (const auto& entry : overdueLoans(currentDate)) {
+            CopyId loan = entry.second;
+            Book* book = bookById(loan.book);
+            if (!book) continue;
+            int borrowerId;
+            {
+                lock_guard<mutex> bookGuard(bookLock(loan.book));
+                borrowerId = book->getCopy(loan.copy).getBorrowerId();
+            }
+            // Only roles with a fine rate incur fines
+            User* user = findUser(borrowerId);
+            Account* account = findAccount(borrowerId);
+            if (!user || !account || rolePolicy(user->getRole()).fineRate == 0) continue;
+
+            lock_guard<mutex> accountGuard(accountLock(borrowerId));
+            lock_guard<mutex> bookGuard(bookLock(loan.book));
+            // The loan may have been returned since overdueLoans() copied it
+            const BookCopy& copy = book->getCopy(loan.copy);
+            if (copy.getStatus() != BookStatus::Borrowed || copy.getBorrowerId() != borrowerId ||
+                copy.getDueDate() != entry.first)
+                continue;
+            accrueFine(borrowerId, *account, loan, *book, rolePolicy(user->getRole()).fineRate, currentDate);
+        }
+    }
+    compactIfNeeded();
+}
+
+// ----- Report export -----
+
+static vector<string> reportColumns(Report report) {
+    switch (report) {
+        case Report::Overdue:
+            return {"isbn", "title", "copy", "user_id", "name", "due_date", "days_overdue"};
+        case Report::Fines:
+            return {"user_id", "name", "role", "email", "fine"};
+        case Report::Circulation:
+            return {"isbn", "title", "author", "copies", "on_loan", "on_hold", "waitlist", "borrowers"};
+        case Report::Activity:
+            return {"user_id", "name", "role", "on_loan", "overdue", "borrowed", "fine"};
+    }
+    return {};
+}
+
+bool Library::exportReport(Report report, const string& path, ReportFormat format) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
+        cout << "Access denied. Only librarians can export reports.\n";
+        return false;
+    }
+    auto start = chrono::steady_clock::now();
+    if (report == Report::Fines) calculateFines(); // charge the days since the last run
+    ReportWriter writer(path, format, reportColumns(report));
+    if (!writer.isOpen()) {
+        cout << "Unable to write " << path << ".\n";
+        return false;
+    }
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        time_t currentDate = getCurrentDate();
+        switch (report) {
+            case Report::Overdue: reportOverdue(writer, currentDate); break;
+            case Report::Fines: reportFines(writer); break;
+            case Report::Circulation: reportCirculation(writer); break;
+            case Report::Activity: reportActivity(writer, currentDate); break;
+        }
+    }
+    if (!writer.finish()) {
+        cout << "Unable to write " << path << ".\n";
+        return false;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << "Exported " << writer.getRows() << (writer.getRows() == 1 ? " row" : " rows") << " to " << path
+         << " in " << fixed << setprecision(3) << seconds << " s.\n";
+    cout.flags(flags);
+    cout.precision(precision);
+    return true;
+}
+
+// dueIndex is walked in batches; a loan returned meanwhile is skipped, and
+// new loans are not due yet, so each overdue loan is listed once
+void Library::reportOverdue(ReportWriter& writer, time_t currentDate) const {
+    const size_t batchSize = 4096;
+    vector<pair<time_t, CopyId>> batch = overdueLoans(currentDate, nullptr, batchSize);
+    while (!batch.empty()) {
+        for (const auto& entry : batch) {
+            CopyId loan = entry.second;
+            const Book* book = bookById(loan.book);
+            if (!book) continue;
+            int borrowerId;
+            {
+                lock_guard<mutex> bookGuard(bookLock(loan.book));
+                const BookCopy& copy = book->getCopy(loan.copy);
+                if (copy.getStatus() != BookStatus::Borrowed || copy.getDueDate() != entry.first) continue;
+                borrowerId = copy.getBorrowerId();
+            }
+            const User* user = findUser(borrowerId);
+            writer.text(book->getISBN());
+            writer.text(book->getTitle());
+            writer.number(static_cast<long long>(loan.copy) + 1);
+            writer.number(static_cast<long long>(borrowerId));
+            writer.text(user ? user->getName() : "");
+            writer.date(entry.first);
+            writer.number(static_cast<long long>(calculateOverdueDays(entry.first, currentDate)));
+            writer.endRow();
+        }
+        if (batch.size() < batchSize) break;
+        batch = overdueLoans(currentDate, &batch.back(), batchSize);
+    }
+}
+void Library::reportFines(ReportWriter& writer) const {
+    for (const auto& entry : users) {
+        auto account = accounts.find(entry.first);
+        if (account == accounts.end()) continue;
+        double fines;
+        {
+            lock_guard<mutex> accountGuard(accountLock(entry.first));
+            fines = account->second.getFines();
+        }
+        if (fines <= 0) continue;
+        const User& user = *entry.second;
+        writer.number(static_cast<long long>(user.getId()));
+        writer.text(user.getName());
+        writer.text(rolePolicy(user.getRole()).name);
+        writer.text(user.getEmail());
+        writer.number(fines);
+        writer.endRow();
+    }
+}
+// Borrower counts come from one pass over the history bitmaps; the copies
+// are read from a View, like a listing
+void Library::reportCirculation(ReportWriter& writer) const {
+    vector<uint32_t> borrowers(bookIds.size());
+    for (const auto& entry : accounts) {
+        vector<BookId> history;
+        {
+            lock_guard<mutex> accountGuard(accountLock(entry.first));
+            history = entry.second.getBorrowHistory().toVector();
+        }
+        for (BookId id : history)
+            if (id < borrowers.size()) ++borrowers[id];
+    }
+    CatalogVersions::View view(versions);
+    for (BookId id : catalogOrder.ids(BookOrder::ISBN)) {
+        const Book* book = bookById(id);
+        long long onLoan = 0, onHold = 0, waiting = 0;
+        if (auto version = view.find(id)) {
+            for (const BookCopy& copy : version->copies) {
+                if (copy.getStatus() == BookStatus::Borrowed) ++onLoan;
+                else if (copy.getStatus() == BookStatus::Reserved) ++onHold;
+            }
+        }
+        {
+            lock_guard<mutex> dueGuard(dueMutex);
+            auto queue = holdQueues.find(id);
+            if (queue != holdQueues.end()) waiting = static_cast<long long>(queue->second.size());
+        }
+        writer.text(book->getISBN());
+        writer.text(book->getTitle());
+        writer.text(book->getAuthor());
+        writer.number(static_cast<long long>(book->getCopyCount()));
+        writer.number(onLoan);
+        writer.number(onHold);
+        writer.number(waiting);
+        writer.number(static_cast<long long>(borrowers[id]));
+        writer.endRow();
+    }
+}
+void Library::reportActivity(ReportWriter& writer, time_t currentDate) const {
+    for (const auto& entry : users) {
+        const User& user = *entry.second;
+        auto account = accounts.find(entry.first);
+        long long onLoan = 0, overdue = 0, borrowed = 0;
+        double fines = 0;
+        if (account != accounts.end()) {
+            lock_guard<mutex> accountGuard(accountLock(entry.first));
+            const Account& state = account->second;
+            for (CopyId loan : state.getBorrowedBooks()) {
+                const Book* book = bookById(loan.book);
+                if (!book) continue;
+                ++onLoan;
+                lock_guard<mutex> bookGuard(bookLock(loan.book));
+                if (calculateOverdueDays(book->getCopy(loan.copy).getDueDate(), currentDate) > 0) ++overdue;
+            }
+            borrowed = static_cast<long long>(state.getBorrowHistory().size());
+            fines = state.getFines();
+        }
+        writer.number(static_cast<long long>(user.getId()));
+        writer.text(user.getName());
+        writer.text(rolePolicy(user.getRole()).name);
+        writer.number(onLoan);
+        writer.number(overdue);
+        writer.number(borrowed);
+        writer.number(fines);
+        writer.endRow();
+    }
+}
+
+// ----- Reservations -----
+
+// The copy of the book that is Reserved for userId, if any. Caller holds the
+// book's stripe.
+bool Library::findHeldCopy(const Book& book, int userId, uint32_t& copy) const {
+    for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+        const BookCopy& state = book.getCopy(i);
+        if (state.getStatus() == BookStatus::Reserved && state.getBorrowerId() == userId) {
+            copy = i;
+            return true;
+        }
+    }
+    return false;
+}
+// Whether userId has a copy of book on loan or on hold. Caller holds the
+// book's stripe or works on a copy of the book.
+static bool hasCopyOf(const Book& book, int userId) {
+    for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+        if (book.getCopy(i).getStatus() != BookStatus::Available && book.getCopy(i).getBorrowerId() == userId)
+            return true;
+    }
+    return false;
+}
+// Hold the copy for the first user in its book's waitlist who still exists.
+// Caller holds the book's stripe and the copy has just become Available.
+void Library::handOff(CopyId copy, Book& book, time_t currentDate) {
+    int next = 0;
+    {
+        lock_guard<mutex> dueGuard(dueMutex);
+        auto queue = holdQueues.find(copy.book);
+        if (queue == holdQueues.end()) return;
+        while (!queue->second.empty() && next == 0) {
+            if (findUser(queue->second.front())) next = queue->second.front();
+            queue->second.pop_front();
+        }
+        if (queue->second.empty()) holdQueues.erase(queue);
+    }
+    if (next == 0) return;
+    BookCopy state;
+    state.setStatus(BookStatus::Reserved);
+    state.setBorrowerId(next);
+    state.setDueDate(currentDate + HOLD_PERIOD);
+    book.setCopy(copy.copy, state);
+    trackLoan(copy, state);
+    logOperation({"hold", book.getISBN(), to_string(next), to_string(state.getDueDate()), to_string(copy.copy + 1)});
+}
+// Copies added to a book go to its waitlist first; returns how many were held.
+// Caller holds catalogMutex exclusively.
+uint32_t Library::handOffNewCopies(BookId id, uint32_t firstNew) {
+    Book* book = bookById(id);
     time_t currentDate = getCurrentDate();
-    for (auto& accPair : accounts) {
-        Account& account = accPair.second;
-        // Only students incur fines
-        User* user = findUser(account.getUserId());
-        if (user && user->getRole() == "Student") {
-            // For each borrowed book, calculate overdue fine if any
-            for (const string& isbn : account.getBorrowedBooks()) {
-                Book* book = findBook(isbn);
-                if (book) {
-                    int overdueDays = calculateOverdueDays(book->getDueDate(), currentDate);
-                    if (overdueDays > 0) {
-                        int fine = overdueDays * Student::getFineRate();
-                        accounts[account.getUserId()].addFine(fine);
-                    }
-                }
+    uint32_t held = 0;
+    for (uint32_t i = firstNew; i < book->getCopyCount(); ++i) {
+        handOff(CopyId{id, i}, *book, currentDate);
+        if (book->getCopy(i).getStatus() == BookStatus::Reserved) ++held;
+    }
+    if (held > 0) publishCopies(id, *book);
+    return held;
+}
+// Caller holds the book's stripe and the copy is Reserved
+void Library::releaseHold(CopyId copy, Book& book) {
+    untrackLoan(copy, book.getCopy(copy.copy));
+    book.setCopy(copy.copy, BookCopy());
+    logOperation({"release-hold", book.getISBN(), to_string(copy.copy + 1)});
+}
+// Walks holdIndex from the earliest expiry, so only expired holds are visited
+void Library::expireHolds() {
+    bool expired = false;
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        time_t currentDate = getCurrentDate();
+        vector<pair<time_t, CopyId>> due;
+        {
+            lock_guard<mutex> dueGuard(dueMutex);
+            for (auto it = holdIndex.begin(); it != holdIndex.end() && it->first < currentDate; ++it)
+                due.push_back(*it);
+        }
+        for (const auto& entry : due) {
+            CopyId copy = entry.second;
+            Book* book = bookById(copy.book);
+            if (!book) continue;
+            lock_guard<mutex> bookGuard(bookLock(copy.book));
+            // The hold may have been picked up or cancelled since it was copied
+            const BookCopy& state = book->getCopy(copy.copy);
+            if (state.getStatus() != BookStatus::Reserved || state.getDueDate() != entry.first)
+                continue;
+            releaseHold(copy, *book);
+            handOff(copy, *book, currentDate);
+            publishCopies(copy.book, *book);
+            expired = true;
+        }
+    }
+    if (expired) compactIfNeeded();
+}
+bool Library::reserveBook(int userId, const string& ISBN) {
+    expireHolds();
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        User* user = findUser(userId);
+        BookId id;
+        if (!user || !findBookId(ISBN, id)) {
+            cerr << "Invalid user or book." << endl;
+            return false;
+        }
+        const RolePolicy& policy = rolePolicy(user->getRole());
+        if (policy.maxBooks == 0) {
+            cout << policy.plural << " cannot reserve books." << endl;
+            return false;
+        }
+        Book* book = bookById(id);
+        lock_guard<mutex> bookGuard(bookLock(id));
+        if (book->getAvailableCount() > 0) {
+            cout << "Book is available, you can borrow it right away." << endl;
+            return false;
+        }
+        uint32_t held;
+        if (findHeldCopy(*book, userId, held)) {
+            cout << "This book is already held for you." << endl;
+            return false;
+        }
+        if (hasCopyOf(*book, userId)) {
+            cout << "You have already borrowed this book." << endl;
+            return false;
+        }
+        lock_guard<mutex> dueGuard(dueMutex);
+        deque<int>& queue = holdQueues[id];
+        if (find(queue.begin(), queue.end(), userId) != queue.end()) {
+            cout << "You are already on the waitlist for this book." << endl;
+            return false;
+        }
+        queue.push_back(userId);
+        logOperation({"reserve", to_string(userId), book->getISBN()});
+        cout << "Book reserved. You are number " << queue.size() << " on the waitlist." << endl;
+    }
+    compactIfNeeded();
+    return true;
+}
+bool Library::cancelReservation(int userId, const string& ISBN) {
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(ISBN, id)) {
+            cout << "Book not found." << endl;
+            return false;
+        }
+        Book* book = bookById(id);
+        lock_guard<mutex> bookGuard(bookLock(id));
+        uint32_t held;
+        if (findHeldCopy(*book, userId, held)) {
+            // Give up a hold that is ready for pickup: it passes to the next user
+            releaseHold(CopyId{id, held}, *book);
+            handOff(CopyId{id, held}, *book, getCurrentDate());
+            publishCopies(id, *book);
+        } else {
+            lock_guard<mutex> dueGuard(dueMutex);
+            auto queue = holdQueues.find(id);
+            if (queue == holdQueues.end() ||
+                find(queue->second.begin(), queue->second.end(), userId) == queue->second.end()) {
+                cout << "You are not on the waitlist for this book." << endl;
+                return false;
             }
+            queue->second.erase(find(queue->second.begin(), queue->second.end(), userId));
+            if (queue->second.empty()) holdQueues.erase(queue);
+            logOperation({"cancel-reservation", to_string(userId), book->getISBN()});
         }
     }
+    compactIfNeeded();
+    cout << "Reservation cancelled." << endl;
+    return true;
+}
+vector<int> Library::waitlistOf(const string& ISBN) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    BookId id;
+    if (!findBookId(ISBN, id)) return {};
+    lock_guard<mutex> dueGuard(dueMutex);
+    auto queue = holdQueues.find(id);
+    if (queue == holdQueues.end()) return {};
+    return vector<int>(queue->second.begin(), queue->second.end());
+}
+vector<string> Library::holdsFor(int userId) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    vector<CopyId> held;
+    {
+        lock_guard<mutex> dueGuard(dueMutex);
+        for (const auto& entry : holdIndex) held.push_back(entry.second);
+    }
+    CatalogVersions::View view(versions);
+    vector<string> isbns;
+    for (CopyId copy : held) {
+        const Book* book = bookById(copy.book);
+        auto version = view.find(copy.book);
+        if (!book || !version || copy.copy >= version->copies.size()) continue;
+        const BookCopy& state = version->copies[copy.copy];
+        if (state.getStatus() == BookStatus::Reserved && state.getBorrowerId() == userId)
+            isbns.push_back(book->getISBN());
+    }
+    return isbns;
+}
+// Menu helper: offer the waitlist when every copy is out
+void Library::borrowOrReserve(const string& ISBN) {
+    int userId = currentUserId;
+    if (borrowBook(userId, ISBN)) return;
+    Book copy;
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        BookId id;
+        if (!findBookId(ISBN, id)) return;
+        CatalogVersions::View view(versions);
+        copy = viewCopy(view, id, *bookById(id));
+    }
+    if (copy.getAvailableCount() > 0 || hasCopyOf(copy, userId)) return;
+    cout << "Join the waitlist for this book? (y/n): ";
+    string answer;
+    getline(cin, answer);
+    if (answer == "y" || answer == "Y") reserveBook(userId, ISBN);
 }
 
 // ----- Authentication -----
 
 bool Library::login(int userId, const string& password) {
+    OperationTimer timer(metrics, Operation::Login);
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
     User* user = findUser(userId);
     if (!user) {
         cout << "User ID not found.\n";
-        return false;
+        return timer.finish(false);
     }
     if (user->getPassword() == password) {
         currentUserId = userId;
         cout << "Login successful. Welcome, " << user->getName() << "!\n";
-        return true;
+        return timer.finish(true);
     } else {
         cout << "Incorrect password.\n";
-        return false;
+        return timer.finish(false);
     }
 }
 void Library::logout() {
     currentUserId = 0;
-    clearScreen();
     cout << "Logged out successfully.\n";
 }
 bool Library::isLoggedIn() const {
@@ -390,6 +1766,7 @@ void Library::displayUserAccount() const {
         return;
     }
     int userId = currentUserId;  // Use the logged-in user ID
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
     auto it = accounts.find(userId);
 
     if (it == accounts.end()) {
@@ -397,17 +1774,184 @@ void Library::displayUserAccount() const {
         return;
     }
     cout << "Account details for " << getCurrentUser()->getName() << ":\n";
+    lock_guard<mutex> accountGuard(accountLock(userId));
     it->second.displayDetails();
 }
 
-void Library::settleFines(int userId) {
-    Account* account = findAccount(userId);
-    if (account) {
+bool Library::settleFines(int userId) {
+    if (!isLoggedIn() || !rolePolicy(getCurrentUser()->getRole()).manages) {
+        cout << "Access denied. Only librarians can settle fines.\n";
+        return false;
+    }
+    {
+        shared_lock<shared_mutex> catalogLock(catalogMutex);
+        Account* account = findAccount(userId);
+        if (!account) {
+            cout << "Account not found for user ID: " << userId << endl;
+            return false;
+        }
+        lock_guard<mutex> accountGuard(accountLock(userId));
         account->payFines();
-        cout << "Fines settled successfully for user ID: " << userId << endl;
-    } else {
-        cout << "Account not found for user ID: " << userId << endl;
+        logOperation({"settle-fines", to_string(userId)});
+    }
+    compactIfNeeded();
+    cout << "Fines settled successfully for user ID: " << userId << endl;
+    return true;
+}
+
+// ----- Borrow history queries -----
+
+bool Library::hasBorrowed(int userId, const string& ISBN) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    BookId id;
+    auto account = accounts.find(userId);
+    if (account == accounts.end() || !findBookId(ISBN, id)) return false;
+    lock_guard<mutex> accountGuard(accountLock(userId));
+    return account->second.getBorrowHistory().contains(id);
+}
+vector<int> Library::borrowersOf(const string& ISBN) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    vector<int> borrowers;
+    BookId id;
+    if (!findBookId(ISBN, id)) return borrowers;
+    for (const auto& pair : accounts) {
+        lock_guard<mutex> accountGuard(accountLock(pair.first));
+        if (pair.second.getBorrowHistory().contains(id))
+            borrowers.push_back(pair.first);
+    }
+    sort(borrowers.begin(), borrowers.end());
+    return borrowers;
+}
+vector<string> Library::commonHistory(int userA, int userB) const {
+    shared_lock<shared_mutex> catalogLock(catalogMutex);
+    auto a = accounts.find(userA);
+    auto b = accounts.find(userB);
+    if (a == accounts.end() || b == accounts.end()) return {};
+    BookBitmap shared;
+    {
+        // Copy one history first so that only one account stripe is held at a time
+        BookBitmap historyA;
+        {
+            lock_guard<mutex> accountGuard(accountLock(userA));
+            historyA = a->second.getBorrowHistory();
+        }
+        lock_guard<mutex> accountGuard(accountLock(userB));
+        shared = historyA.intersect(b->second.getBorrowHistory());
+    }
+    vector<BookId> ids = shared.toVector();
+    sortByISBN(ids);
+    vector<string> isbns;
+    for (BookId id : ids) isbns.push_back(bookIds.getISBN(id));
+    return isbns;
+}
+
+// Latency percentiles come from log-linear histograms, so they are upper
+// bounds within 1/8 of the value
+void Library::displayPerformanceReport() const {
+    metrics.report(cout);
+    if (!metricsPath.empty()) cout << "Written to " << metricsPath << " on exit.\n";
+}
+
+size_t Library::verifyConsistency(ostream& out) const {
+    unique_lock<shared_mutex> catalogLock(catalogMutex);
+    size_t problems = 0;
+    size_t borrowedCount = 0, reservedCount = 0;
+    for (const auto& pair : books) {
+        const Book& book = pair.second;
+        const string isbn = book.getISBN();
+        size_t availableCount = 0;
+        for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+            const BookCopy& state = book.getCopy(i);
+            const CopyId copy{pair.first, i};
+            const string name = book.getCopyCount() > 1 ? isbn + " copy " + to_string(i + 1) : isbn;
+            if (state.getStatus() == BookStatus::Reserved) {
+                ++reservedCount;
+                if (!holdIndex.count({state.getDueDate(), copy})) {
+                    out << "Book " << name << " is missing from the hold index" << endl;
+                    ++problems;
+                }
+                continue;
+            }
+            if (state.getStatus() != BookStatus::Borrowed) {
+                ++availableCount;
+                if (state.getBorrowerId() != 0) {
+                    out << "Book " << name << " is not borrowed but has borrower " << state.getBorrowerId() << endl;
+                    ++problems;
+                }
+                continue;
+            }
+            ++borrowedCount;
+            auto account = accounts.find(state.getBorrowerId());
+            const vector<CopyId> noLoans;
+            const vector<CopyId>& loans = account != accounts.end() ? account->second.getBorrowedBooks() : noLoans;
+            if (count(loans.begin(), loans.end(), copy) != 1) {
+                out << "Book " << name << " is not listed exactly once by its borrower " << state.getBorrowerId() << endl;
+                ++problems;
+            }
+            if (!dueIndex.count({state.getDueDate(), copy})) {
+                out << "Book " << name << " is missing from the due-date index" << endl;
+                ++problems;
+            }
+        }
+        auto version = versions.newest(pair.first);
+        bool published = version && version->copies.size() == book.getCopyCount();
+        for (uint32_t i = 0; published && i < book.getCopyCount(); ++i) {
+            const BookCopy& a = version->copies[i];
+            const BookCopy& b = book.getCopy(i);
+            published = a.getStatus() == b.getStatus() && a.getBorrowerId() == b.getBorrowerId() &&
+                        a.getBorrowDate() == b.getBorrowDate() && a.getDueDate() == b.getDueDate();
+        }
+        if (!published) {
+            out << "Book " << isbn << " differs from the version readers see" << endl;
+            ++problems;
+        }
+        if (availableCount != book.getAvailableCount()) {
+            out << "Book " << isbn << " has " << availableCount << " available copies, but its free list holds "
+                << book.getAvailableCount() << endl;
+            ++problems;
+        }
+    }
+    for (const auto& pair : accounts) {
+        const vector<CopyId>& loans = pair.second.getBorrowedBooks();
+        for (const auto& entry : pair.second.getFineLedger()) {
+            if (find(loans.begin(), loans.end(), entry.first) == loans.end()) {
+                out << "Account " << pair.first << " has a fine ledger entry for " << bookIds.getISBN(entry.first.book)
+                    << " which it has not borrowed" << endl;
+                ++problems;
+            }
+        }
+        for (CopyId loan : loans) {
+            const Book* book = bookById(loan.book);
+            if (!book || loan.copy >= book->getCopyCount() ||
+                book->getCopy(loan.copy).getStatus() != BookStatus::Borrowed ||
+                book->getCopy(loan.copy).getBorrowerId() != pair.first) {
+                out << "Account " << pair.first << " lists " << bookIds.getISBN(loan.book) << " which it has not borrowed" << endl;
+                ++problems;
+            }
+        }
     }
+    if (dueIndex.size() != borrowedCount) {
+        out << "Due-date index holds " << dueIndex.size() << " loans, but " << borrowedCount << " books are borrowed" << endl;
+        ++problems;
+    }
+    if (holdIndex.size() != reservedCount) {
+        out << "Hold index holds " << holdIndex.size() << " holds, but " << reservedCount << " books are reserved" << endl;
+        ++problems;
+    }
+    for (const auto& pair : holdQueues) {
+        if (pair.second.empty() || !books.count(pair.first)) {
+            out << "Waitlist for " << bookIds.getISBN(pair.first) << " is empty or has no book" << endl;
+            ++problems;
+        }
+    }
+    for (BookOrder order : {BookOrder::ISBN, BookOrder::Title, BookOrder::Author, BookOrder::Publisher, BookOrder::Year}) {
+        if (catalogOrder.ids(order).size() != books.size()) {
+            out << "Listing by " << bookOrderName(order) << " holds " << catalogOrder.ids(order).size()
+                << " books, but the catalog has " << books.size() << endl;
+            ++problems;
+        }
+    }
+    return problems;
 }
 
 // ----- Run the Library System (Simple CLI) -----
@@ -421,16 +1965,16 @@ void Library::run(){
             displayLoginMenu();
         } 
         else{
-            User* currentUser = getCurrentUser();
-            string role = currentUser->getRole();
+            expireHolds();
+            const RolePolicy& policy = rolePolicy(getCurrentUser()->getRole());
             clearScreen();
             displayHeader();
-            if (role == "Student") {
+            if (policy.manages) {
+                displayLibrarianMenu();
+            } else if (policy.fineRate > 0) {
                 displayStudentMenu();
-            } else if (role == "Faculty") {
+            } else {
                 displayFacultyMenu();
-            } else if (role == "Librarian") {
-                displayLibrarianMenu();
             }
         }
         
@@ -441,13 +1985,12 @@ void Library::run(){
             running = false;
         }
         else if(isLoggedIn()){
-            User* currentUser = getCurrentUser();
-            string role = currentUser->getRole();
-            if(role == "Librarian"){
+            const RolePolicy& policy = rolePolicy(getCurrentUser()->getRole());
+            if (policy.manages) {
                 processLibrarianMenuChoice(input);
-            } else if(role == "Student"){
+            } else if (policy.fineRate > 0) {
                 processStudentMenuChoice(input);
-            } else if(role == "Faculty"){
+            } else {
                 processFacultyMenuChoice(input);
             }
         }
@@ -480,15 +2023,17 @@ void Library::displayHeader() {
     
     if (isLoggedIn()) {
         User* user = getCurrentUser();
-        cout << "Logged in as: " << user->getName() << " (" << user->getRole() << ")\n";
+        cout << "Logged in as: " << user->getName() << " (" << user->getRoleName() << ")\n";
         
-        // For students, show fines if any
-        if (user->getRole() == "Student") {
+        // For roles with fines, show them if any
+        if (rolePolicy(user->getRole()).fineRate > 0) {
             Account* account = findAccount(user->getId());
             if (account && account->getFines() > 0) {
                 cout << "Outstanding fines: Rs. " << account->getFines() << "\n";
             }
         }
+        for (const string& isbn : holdsFor(user->getId()))
+            cout << "Reserved for you, ready to borrow: " << isbn << "\n";
     }
     
     cout << "--------------------------------------------------\n";
@@ -539,7 +2084,8 @@ void Library::displayBooksManagementMenu() {
     cout << "3. Add a new book\n";
     cout << "4. Update an existing book\n";
     cout << "5. Remove a book\n";
-    cout << "6. Back to main menu\n";
+    cout << "6. Import books from CSV\n";
+    cout << "7. Back to main menu\n";
 }
 
 void Library::displayUserManagementMenu() {
@@ -547,14 +2093,18 @@ void Library::displayUserManagementMenu() {
     cout << "1. Display all users\n";
     cout << "2. Add a new user\n";
     cout << "3. Remove a user\n";
-    cout << "4. Back to main menu\n";
+    cout << "4. Import users from CSV\n";
+    cout << "5. Back to main menu\n";
 }
 
 void Library::displaySystemReportsMenu() {
     cout << "\nSYSTEM REPORTS\n";
     cout << "1. Overdue books report\n";
     cout << "2. User fines report\n";
-    cout << "3. Back to main menu\n";
+    cout << "3. Export data to text files\n";
+    cout << "4. System performance\n";
+    cout << "5. Export a report to CSV/JSON\n";
+    cout << "6. Back to main menu\n";
 }
 
 void Library::processLibrarianMenuChoice(const string& choice) {
@@ -591,6 +2141,7 @@ void Library::processLibrarianMenuChoice(const string& choice) {
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
     } else if (choice == "5") { // Logout
+        clearScreen();
         logout();
     } else {
         cout << "Invalid choice. Please try again.\n";
@@ -634,17 +2185,15 @@ void Library::processStudentMenuChoice(const string& choice) {
             displayHeader();
             cout << "\nALL BOOKS:\n";
             displayAllBooks();
-            cout << "\nPress Enter to continue...";
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
         case 2: { // Search books
             string keyword;
-            cout << "Enter search keyword: ";
+            cout << "Enter search keyword (or words:<words>, author:<name>, publisher:<name>, year:<from>-<to>): ";
             getline(cin, keyword);
             clearScreen();
             displayHeader();
             cout << "\nSEARCH RESULTS FOR '" << keyword << "':\n";
-            searchBooks(keyword);
+            displaySearchResults(keyword);
             cout << "\nPress Enter to continue...";
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
@@ -661,7 +2210,7 @@ void Library::processStudentMenuChoice(const string& choice) {
             cout << "Enter ISBN of the book to borrow: ";
             getline(cin, ISBN);
             
-            borrowBook(getCurrentUser()->getId(), ISBN);
+            borrowOrReserve(ISBN);
             cout << "\nPress Enter to continue...";
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
@@ -682,8 +2231,8 @@ void Library::processStudentMenuChoice(const string& choice) {
             cout << "BORROW HISTORY:\n";
             Account* account = findAccount(getCurrentUser()->getId());
             if (account) {
-                for (const string& isbn : account->getBorrowHistory()) {
-                    Book* book = findBook(isbn);
+                for (BookId id : account->getBorrowHistory().toVector()) {
+                    Book* book = bookById(id);
                     if (book) {
                         cout << "ISBN: " << book->getISBN() << endl;
                         cout << "Title: " << book->getTitle() << endl;
@@ -701,14 +2250,16 @@ void Library::processStudentMenuChoice(const string& choice) {
             cout << "DUE BOOKS:\n";
             Account* account = findAccount(getCurrentUser()->getId());
             if (account) {
-                for (const string& isbn : account->getBorrowedBooks()) {
-                    Book* book = findBook(isbn);
-                    if (book->getStatus()=="Borrowed") {
+                for (CopyId loan : account->getBorrowedBooks()) {
+                    Book* book = bookById(loan.book);
+                    if (book && book->getCopy(loan.copy).getStatus() == BookStatus::Borrowed) {
+                        const BookCopy& state = book->getCopy(loan.copy);
                         cout << "ISBN: " << book->getISBN() << endl;
                         cout << "Title: " << book->getTitle() << endl;
-                        cout << "Borrowed on: " << formatDate(book->getBorrowDate()) << endl;
-                        cout << "Due date: " << formatDate(book->getDueDate()) << endl;
-                        cout << "Overdue by: " << calculateOverdueDays(book->getDueDate(), getCurrentDate()) << " days\n";
+                        if (book->getCopyCount() > 1) cout << "Copy: " << loan.copy + 1 << endl;
+                        cout << "Borrowed on: " << formatDate(state.getBorrowDate()) << endl;
+                        cout << "Due date: " << formatDate(state.getDueDate()) << endl;
+                        cout << "Overdue by: " << calculateOverdueDays(state.getDueDate(), getCurrentDate()) << " days\n";
                         cout << endl;
                     }
                 }
@@ -718,6 +2269,7 @@ void Library::processStudentMenuChoice(const string& choice) {
             break;
         }
         case 8: // Logout
+            clearScreen();
             logout();
             break;
         default:
@@ -733,18 +2285,16 @@ void Library::processFacultyMenuChoice(const string& choice) {
             displayHeader();
             cout << "\nALL BOOKS:\n";
             displayAllBooks();
-            cout << "\nPress Enter to continue...";
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
         case 2: { // Search books
             string keyword;
-            cout << "Enter search keyword: ";
+            cout << "Enter search keyword (or words:<words>, author:<name>, publisher:<name>, year:<from>-<to>): ";
             getline(cin, keyword);
             
             clearScreen();
             displayHeader();
             cout << "\nSEARCH RESULTS FOR '" << keyword << "':\n";
-            searchBooks(keyword);
+            displaySearchResults(keyword);
             cout << "\nPress Enter to continue...";
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
@@ -761,7 +2311,7 @@ void Library::processFacultyMenuChoice(const string& choice) {
             cout << "Enter ISBN of the book to borrow: ";
             getline(cin, ISBN);
             
-            borrowBook(getCurrentUser()->getId(), ISBN);
+            borrowOrReserve(ISBN);
             cout << "\nPress Enter to continue...";
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             break;
@@ -782,8 +2332,8 @@ void Library::processFacultyMenuChoice(const string& choice) {
             cout << "BORROW HISTORY:\n";
             Account* account = findAccount(getCurrentUser()->getId());
             if (account) {
-                for (const string& isbn : account->getBorrowHistory()) {
-                    Book* book = findBook(isbn);
+                for (BookId id : account->getBorrowHistory().toVector()) {
+                    Book* book = bookById(id);
                     if (book) {
                         cout << "ISBN: " << book->getISBN() << endl;
                         cout << "Title: " << book->getTitle() << endl;
@@ -801,14 +2351,16 @@ void Library::processFacultyMenuChoice(const string& choice) {
             cout << "DUE BOOKS:\n";
             Account* account = findAccount(getCurrentUser()->getId());
             if (account) {
-                for (const string& isbn : account->getBorrowedBooks()) {
-                    Book* book = findBook(isbn);
-                    if (book->getStatus()=="Borrowed") {
+                for (CopyId loan : account->getBorrowedBooks()) {
+                    Book* book = bookById(loan.book);
+                    if (book && book->getCopy(loan.copy).getStatus() == BookStatus::Borrowed) {
+                        const BookCopy& state = book->getCopy(loan.copy);
                         cout << "ISBN: " << book->getISBN() << endl;
                         cout << "Title: " << book->getTitle() << endl;
-                        cout << "Borrowed on: " << formatDate(book->getBorrowDate()) << endl;
-                        cout << "Due date: " << formatDate(book->getDueDate()) << endl;
-                        cout << "Overdue by: " << calculateOverdueDays(book->getDueDate(), getCurrentDate()) << " days\n";
+                        if (book->getCopyCount() > 1) cout << "Copy: " << loan.copy + 1 << endl;
+                        cout << "Borrowed on: " << formatDate(state.getBorrowDate()) << endl;
+                        cout << "Due date: " << formatDate(state.getDueDate()) << endl;
+                        cout << "Overdue by: " << calculateOverdueDays(state.getDueDate(), getCurrentDate()) << " days\n";
                         cout << endl;
                     }
                 }
@@ -818,6 +2370,7 @@ void Library::processFacultyMenuChoice(const string& choice) {
             break;
         }
         case 8: // Logout
+            clearScreen();
             logout();
             break;
         default:
@@ -832,17 +2385,15 @@ void Library::processLibrarianBooksMenuChoice(const string& choice) {
         displayHeader();
         cout << "\nALL BOOKS:\n";
         displayAllBooks();
-        cout << "\nPress Enter to continue...";
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
     } else if (choice == "2") { // Search books
         string keyword;
-        cout << "Enter search keyword: ";
+        cout << "Enter search keyword (or words:<words>, author:<name>, publisher:<name>, year:<from>-<to>): ";
         getline(cin, keyword);
         
         clearScreen();
         displayHeader();
         cout << "\nSEARCH RESULTS FOR '" << keyword << "':\n";
-        searchBooks(keyword);
+        displaySearchResults(keyword);
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
     } else if (choice == "3") { // Add a new book
@@ -865,7 +2416,12 @@ void Library::processLibrarianBooksMenuChoice(const string& choice) {
         cout << "Enter ISBN: ";
         getline(cin, ISBN);
         
-        Book newBook(title, author, publisher, year, ISBN);
+        int copies;
+        cout << "Enter number of copies: ";
+        cin >> copies;
+        cin.ignore(); // Clear newline
+        
+        Book newBook(title, author, publisher, year, ISBN, max(copies, 0));
         addBook(newBook);
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -874,29 +2430,37 @@ void Library::processLibrarianBooksMenuChoice(const string& choice) {
         cout << "Enter ISBN of the book to update: ";
         getline(cin, ISBN);
         
-        Book* book = findBook(ISBN);
-        if (book) {
+        Book* found = findBook(ISBN);
+        if (found) {
+            Book book = *found; // edit a copy; updateBook() replaces the stored one
             string title, author, publisher;
             int year;
             
             cout << "Enter new title (or press Enter to keep current): ";
             getline(cin, title);
-            if (!title.empty()) book->setTitle(title);
+            if (!title.empty()) book.setTitle(title);
             
             cout << "Enter new author (or press Enter to keep current): ";
             getline(cin, author);
-            if (!author.empty()) book->setAuthor(author);
+            if (!author.empty()) book.setAuthor(author);
             
             cout << "Enter new publisher (or press Enter to keep current): ";
             getline(cin, publisher);
-            if (!publisher.empty()) book->setPublisher(publisher);
+            if (!publisher.empty()) book.setPublisher(publisher);
             
             cout << "Enter new publication year (or 0 to keep current): ";
             cin >> year;
             cin.ignore(); // Clear newline
-            if (year != 0) book->setYear(year);
+            if (year != 0) book.setYear(year);
             
-            updateBook(*book);
+            int copies;
+            cout << "Enter new number of copies (or 0 to keep current): ";
+            cin >> copies;
+            cin.ignore(); // Clear newline
+            if (copies > 0 && !book.setCopyCount(copies))
+                cout << "Only copies that are available can be removed.\n";
+            else
+                updateBook(book);
         } else {
             cout << "Book not found.\n";
         }
@@ -911,7 +2475,16 @@ void Library::processLibrarianBooksMenuChoice(const string& choice) {
         removeBook(ISBN);
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    } else if (choice == "6") { // Back to main menu
+    } else if (choice == "6") { // Import books from CSV
+        string path;
+        cout << "CSV columns: title,author,publisher,year,ISBN[,copies]\n";
+        cout << "Enter path of the CSV file: ";
+        getline(cin, path);
+
+        importBooksCsv(path);
+        cout << "\nPress Enter to continue...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    } else if (choice == "7") { // Back to main menu
     } else {
         cout << "Invalid choice. Please try again.\n";
     }
@@ -944,32 +2517,16 @@ void Library::processLibrarianUsersMenuChoice(const string& choice) {
         getline(cin, password);
 
         cout << "Select user type:\n";
-        cout << "1. Student\n";
-        cout << "2. Faculty\n";
-        cout << "3. Librarian\n";
+        for (size_t i = 0; i < roleCount(); ++i)
+            cout << i + 1 << ". " << userRoleName(static_cast<UserRole>(i)) << "\n";
         cout << "Enter choice: ";
         cin >> userType;
         cin.ignore(); // Clear newline
         
-        User* newUser = nullptr;
-        switch (userType) {
-            case 1:
-                newUser = new Student(id, name, email, password);
-                break;
-            case 2:
-                newUser = new Faculty(id, name, email, password);
-                break;
-            case 3:
-                newUser = new Librarian(id, name, email, password);
-                break;
-            default:
-                cout << "Invalid user type.\n";
-                break;
-        }
-        
-        if (newUser) {
-            addUser(newUser);
-        }
+        if (userType >= 1 && static_cast<size_t>(userType) <= roleCount())
+            addUser(User(id, name, email, password, static_cast<UserRole>(userType - 1)));
+        else
+            cout << "Invalid user type.\n";
         
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -982,7 +2539,16 @@ void Library::processLibrarianUsersMenuChoice(const string& choice) {
         removeUser(userId);
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    } else if (choice == "4") { // Back to main menu
+    } else if (choice == "4") { // Import users from CSV
+        string path;
+        cout << "CSV columns: role,id,name,email,password\n";
+        cout << "Enter path of the CSV file: ";
+        getline(cin, path);
+
+        importUsersCsv(path);
+        cout << "\nPress Enter to continue...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    } else if (choice == "5") { // Back to main menu
     } else {
         cout << "Invalid choice. Please try again.\n";
     }
@@ -1000,14 +2566,15 @@ void Library::processLibrarianReportsMenuChoice(const string& choice) {
         clearScreen();
         displayHeader();
         cout << "\nUSER FINES REPORT:\n";
+        calculateFines(); // charge the days since the last run
         
         bool foundFines = false;
-        for (const auto& pair : accounts) {
-            if (pair.second.getFines() > 0) {
-                User* user = findUser(pair.first);
+        for (const auto* entry : accounts.inKeyOrder()) {
+            if (entry->second.getFines() > 0) {
+                User* user = findUser(entry->first);
                 if (user) {
                     cout << "User: " << user->getName() << " (ID: " << user->getId() 
-                              << ") - Fine: Rs." << pair.second.getFines() << endl;
+                              << ") - Fine: Rs." << entry->second.getFines() << endl;
                     foundFines = true;
                 }
             }
@@ -1020,7 +2587,41 @@ void Library::processLibrarianReportsMenuChoice(const string& choice) {
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
-    else if (choice == "3") { // Back to main menu
+    else if (choice == "3") { // Export data to text files
+        if (exportTextData(dataDirectory))
+            cout << "Data exported to " << dataDirectory << "/books.txt, users.txt and accounts.txt\n";
+        cout << "\nPress Enter to continue...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    else if (choice == "4") { // System performance
+        clearScreen();
+        displayHeader();
+        cout << "\nSYSTEM PERFORMANCE:\n";
+        displayPerformanceReport();
+        cout << "\nPress Enter to continue...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    else if (choice == "5") { // Export a report to CSV/JSON
+        string name, formatName, path;
+        Report report;
+        ReportFormat format;
+        cout << "Report (overdue, fines, circulation, activity): ";
+        getline(cin, name);
+        cout << "Format (csv, json): ";
+        getline(cin, formatName);
+        if (!reportFromName(name, report)) {
+            cout << "Unknown report " << name << ".\n";
+        } else if (!reportFormatFromName(formatName, format)) {
+            cout << "Unknown format " << formatName << ".\n";
+        } else {
+            cout << "Enter path of the file: ";
+            getline(cin, path);
+            exportReport(report, path, format);
+        }
+        cout << "\nPress Enter to continue...";
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    else if (choice == "6") { // Back to main menu
     }
     else{
         cout << "Invalid choice. Please try again.\n";
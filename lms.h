@@ -3,13 +3,26 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <ctime>
 #include <map>
+#include <set>
+#include <memory>
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
 /*
 Classes:
 • Create at least four classes: User, Book, Account, and Library.
@@ -33,12 +46,289 @@ using namespace std;
 
 class Book;
 class User;
-class Student;
-class Faculty;
-class Librarian;
 class Account;
 class Library;
 
+// Book status and user role are stored as small enums. Their names
+// ("Available", "Student", ...) are the stable mapping used by the text files
+// and the journal; the snapshot stores the numeric values. Roles defined in
+// roles.txt are numbered after the three built-in ones.
+enum class BookStatus : uint8_t { Available = 0, Borrowed = 1, Reserved = 2 };
+enum class UserRole : uint8_t { Student = 0, Faculty = 1, Librarian = 2 };
+
+string bookStatusName(BookStatus status);
+bool bookStatusFromName(string_view name, BookStatus& status);
+string userRoleName(UserRole role);
+bool userRoleFromName(string_view name, UserRole& role);
+
+// Borrowing rules of a role. A day is one minute while testing (see
+// calculateOverdueDays).
+struct RolePolicy {
+    string name;            // as in users.txt and the journal
+    string plural;          // for messages, e.g. "Faculty members"
+    int maxBooks = 0;       // loans at a time; 0: cannot borrow or reserve
+    int loanDays = 0;
+    int fineRate = 0;       // rupees per overdue day; fined roles must pay before borrowing again
+    int maxOverdueDays = -1; // no new loans while one is overdue by more; -1: no limit
+    bool manages = false;   // may manage books and users and settle fines
+};
+
+// The role table, indexed by UserRole. It holds the built-in Student, Faculty
+// and Librarian rules until loadRolePolicies() reads roles.txt, which the
+// Library does at startup before any other thread runs. Returns false if the
+// file does not exist; malformed lines are skipped and reported in errors.
+const RolePolicy& rolePolicy(UserRole role);
+size_t roleCount();
+bool loadRolePolicies(const string& path, vector<string>& errors);
+
+// Books are keyed by their ISBN-13 as a number. parseISBN accepts an ISBN-10
+// or ISBN-13 (hyphens and spaces are ignored), verifies its check digit and
+// converts ISBN-10 to the equivalent 978-prefixed ISBN-13. formatISBN gives
+// back the canonical 13-digit form, which is what the Library stores.
+bool parseISBN(string_view text, uint64_t& key);
+string formatISBN(uint64_t key);
+
+// Open-addressing hash table for integer keys. Entries are stored
+// contiguously in a vector; the slot array (linear probing) holds each key
+// with the position of its entry, so a lookup touches one or two cache lines.
+// Iteration is in no particular order; inKeyOrder() sorts pointers to the
+// entries when an ordered view is needed. Any insert or erase invalidates
+// iterators and pointers to entries.
+template <typename Key, typename Value>
+class FlatHashMap {
+public:
+    using Entry = pair<Key, Value>;
+    using iterator = typename vector<Entry>::iterator;
+    using const_iterator = typename vector<Entry>::const_iterator;
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    struct Slot {
+        Key key;
+        uint32_t index; // position in entries, EMPTY if the slot is free
+    };
+    vector<Entry> entries;
+    vector<Slot> slots; // size is 0 or a power of two
+    size_t mask = 0;
+
+    static size_t hashKey(Key key) {
+        uint64_t x = static_cast<uint64_t>(key);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+    // Slot holding key, or the free slot where it would be inserted
+    size_t slotOf(Key key) const {
+        size_t i = hashKey(key) & mask;
+        while (slots[i].index != EMPTY && slots[i].key != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+    void rehash(size_t capacity) {
+        slots.assign(capacity, Slot{Key(), EMPTY});
+        mask = capacity - 1;
+        for (size_t i = 0; i < entries.size(); ++i)
+            slots[slotOf(entries[i].first)] = Slot{entries[i].first, static_cast<uint32_t>(i)};
+    }
+
+    // Keep the load factor at or below 3/4
+    void growSlots(size_t count) {
+        if (count * 4 <= slots.size() * 3) return;
+        size_t capacity = 16;
+        while (capacity * 3 < count * 4) capacity *= 2;
+        rehash(capacity);
+    }
+
+public:
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    void reserve(size_t count) {
+        growSlots(count);
+        entries.reserve(count);
+    }
+    void clear() {
+        entries.clear();
+        slots.clear();
+        mask = 0;
+    }
+
+    iterator find(Key key) {
+        if (slots.empty()) return entries.end();
+        const Slot& slot = slots[slotOf(key)];
+        return slot.index == EMPTY ? entries.end() : entries.begin() + slot.index;
+    }
+    const_iterator find(Key key) const {
+        if (slots.empty()) return entries.end();
+        const Slot& slot = slots[slotOf(key)];
+        return slot.index == EMPTY ? entries.end() : entries.begin() + slot.index;
+    }
+    size_t count(Key key) const { return find(key) != end() ? 1 : 0; }
+
+    // Insert (key, value) unless key is present; like map::emplace
+    pair<iterator, bool> emplace(Key key, Value value) {
+        growSlots(entries.size() + 1);
+        size_t i = slotOf(key);
+        if (slots[i].index != EMPTY) return {entries.begin() + slots[i].index, false};
+        slots[i] = Slot{key, static_cast<uint32_t>(entries.size())};
+        entries.emplace_back(key, move(value));
+        return {entries.end() - 1, true};
+    }
+    Value& operator[](Key key) {
+        return emplace(key, Value()).first->second;
+    }
+
+    // Remove key. The last entry moves into the freed position, and the
+    // probe chain is closed by shifting later slots back (no tombstones).
+    size_t erase(Key key) {
+        if (slots.empty()) return 0;
+        size_t hole = slotOf(key);
+        if (slots[hole].index == EMPTY) return 0;
+        uint32_t removed = slots[hole].index;
+        for (size_t i = (hole + 1) & mask; slots[i].index != EMPTY; i = (i + 1) & mask) {
+            size_t home = hashKey(slots[i].key) & mask;
+            // Move slot i into the hole unless its home lies cyclically in (hole, i]
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].index = EMPTY;
+        uint32_t last = static_cast<uint32_t>(entries.size() - 1);
+        if (removed != last) {
+            entries[removed] = move(entries[last]);
+            slots[slotOf(entries[removed].first)].index = removed;
+        }
+        entries.pop_back();
+        return 1;
+    }
+    void erase(iterator it) { erase(it->first); }
+
+    // Pointers to all entries sorted by key, for listings and exports
+    vector<const Entry*> inKeyOrder() const {
+        vector<const Entry*> ordered;
+        ordered.reserve(entries.size());
+        for (const auto& entry : entries) ordered.push_back(&entry);
+        sort(ordered.begin(), ordered.end(), [](const Entry* a, const Entry* b) { return a->first < b->first; });
+        return ordered;
+    }
+};
+
+// Dense 32-bit ID of an ISBN. Accounts, the search indexes and the due-date
+// index refer to books by ID instead of holding ISBN strings.
+using BookId = uint32_t;
+
+// One physical copy of a book: the title's BookId and the copy's position in
+// its copies (0-based; files and screens number copies from 1). Loans, the
+// due-date and hold indexes and the fine ledger refer to copies, while borrow
+// histories, waitlists and the search indexes stay per title.
+struct CopyId {
+    BookId book;
+    uint32_t copy;
+};
+inline bool operator==(CopyId a, CopyId b) { return a.book == b.book && a.copy == b.copy; }
+inline bool operator!=(CopyId a, CopyId b) { return !(a == b); }
+inline bool operator<(CopyId a, CopyId b) { return a.book != b.book ? a.book < b.book : a.copy < b.copy; }
+
+// Interns ISBNs into BookIds. IDs are handed out in the order ISBNs are first
+// seen and are never reused: a removed book keeps its ID because borrow
+// histories still refer to it. The snapshot stores the table, so IDs stay
+// the same across restarts.
+class BookIdTable {
+private:
+    FlatHashMap<uint64_t, BookId> ids; // ISBN key -> ID
+    vector<uint64_t> keys;             // ID -> ISBN key
+
+public:
+    // ID of key, assigning the next free ID if key is new
+    BookId intern(uint64_t key);
+    bool find(uint64_t key, BookId& id) const;
+    bool contains(BookId id) const;
+    uint64_t getKey(BookId id) const;
+    string getISBN(BookId id) const;
+    const vector<uint64_t>& getKeys() const;
+    size_t size() const;
+    void clear();
+};
+
+// Compressed set of BookIds in the style of a roaring bitmap. IDs are grouped
+// by their high 16 bits into containers; a container holds its low 16 bits as
+// a sorted array while it has at most ARRAY_MAX members and switches to a
+// 65536-bit bitmap beyond that (the point where the bitmap becomes smaller).
+// Membership is a search over the few containers plus a bit test or a binary
+// search in at most 4096 entries.
+class BookBitmap {
+private:
+    static const uint32_t ARRAY_MAX = 4096;
+    static const size_t BITMAP_WORDS = 65536 / 64;
+    struct Container {
+        uint16_t high;
+        uint32_t cardinality;
+        vector<uint16_t> array; // sorted low bits, while cardinality <= ARRAY_MAX
+        vector<uint64_t> bits;  // BITMAP_WORDS words once the container is a bitmap
+    };
+    vector<Container> containers; // sorted by high
+    size_t count;
+
+    const Container* findContainer(uint16_t high) const;
+
+public:
+    BookBitmap();
+
+    // Returns false if id was already present
+    bool add(BookId id);
+    bool contains(BookId id) const;
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    BookId maxId() const; // largest member; the set must not be empty
+
+    // Members in ascending order
+    vector<BookId> toVector() const;
+    // Members of both sets
+    BookBitmap intersect(const BookBitmap& other) const;
+
+    // Binary form used by the snapshot: container count, then per container
+    // its high bits, kind, cardinality and the array or bitmap payload.
+    void serialize(string& out) const;
+    bool deserialize(const char* data, size_t size);
+};
+
+using BookTable = FlatHashMap<BookId, Book>;
+using AccountTable = FlatHashMap<int, Account>;
+using HoldQueues = FlatHashMap<BookId, deque<int>>; // users waiting for a book, first in line first
+
+// Circulation state of one physical copy of a book
+class BookCopy {
+private:
+    BookStatus status;
+    int borrowerId; // borrower, or the user a Reserved copy is held for (0 if Available)
+    time_t borrowDate; // Date when the copy was borrowed
+    time_t dueDate; // Date when the copy is due to be returned, or when its hold ends
+
+public:
+    BookCopy();
+
+    BookStatus getStatus() const;
+    string getStatusName() const;
+    int getBorrowerId() const;
+    time_t getBorrowDate() const;
+    time_t getDueDate() const;
+
+    void setStatus(BookStatus status);
+    void setBorrowerId(int id);
+    void setBorrowDate(time_t date);
+    void setDueDate(time_t date);
+};
+
+// A title in the catalog (bibliographic record) with its physical copies
 class Book {
 private:
     string title;
@@ -46,26 +336,26 @@ private:
     string publisher;
     int year;
     string ISBN;
-    string status; // Available, Borrowed, Reserved
-    int borrowerId; // ID of the user who borrowed the book (0 if not borrowed)
-    time_t borrowDate; // Date when the book was borrowed
-    time_t dueDate; // Date when the book is due to be returned
+    vector<BookCopy> copies;
+    vector<uint32_t> freeCopies; // numbers of the Available copies, used as a stack
+    vector<uint32_t> freeSlot;   // per copy its position in freeCopies (NOT_FREE if none)
+
+    static constexpr uint32_t NOT_FREE = UINT32_MAX;
+    void updateFreeList(uint32_t copy);
+    void unlistFree(uint32_t copy);
 
 public:
     // Constructors
     Book();
-    Book(const string& title, const string& author, const string& publisher, int year, const string& ISBN);
+    Book(const string& title, const string& author, const string& publisher, int year, const string& ISBN,
+         size_t copyCount = 1);
 
     // Getters
-    string getTitle() const;
-    string getAuthor() const;
-    string getPublisher() const;
+    const string& getTitle() const;
+    const string& getAuthor() const;
+    const string& getPublisher() const;
     int getYear() const;
-    string getISBN() const;
-    string getStatus() const;
-    int getBorrowerId() const;
-    time_t getBorrowDate() const;
-    time_t getDueDate() const;
+    const string& getISBN() const;
 
     // Setters
     void setTitle(const string& title);
@@ -73,16 +363,26 @@ public:
     void setPublisher(const string& publisher);
     void setYear(int year);
     void setISBN(const string& ISBN);
-    void setStatus(const string& status);
-    void setBorrowerId(int id);
-    void setBorrowDate(time_t date);
-    void setDueDate(time_t date);
 
-    // Display book details
+    // Copies. Their state only changes through setCopy(), which keeps the
+    // free list of Available copies up to date, so findFreeCopy() is O(1).
+    size_t getCopyCount() const;
+    size_t getAvailableCount() const;
+    const BookCopy& getCopy(uint32_t copy) const;
+    const vector<BookCopy>& getCopies() const;
+    void setCopy(uint32_t copy, const BookCopy& state);
+    void setCopies(const vector<BookCopy>& states); // all of them, also their number
+    bool findFreeCopy(uint32_t& copy) const;
+    // Add Available copies, or drop copies from the end; returns false (and
+    // changes nothing) if a copy to be dropped is not Available.
+    bool setCopyCount(size_t count);
+
+    // Display book details; appendDetails adds the same text to out
     void displayDetails() const;
+    void appendDetails(string& out) const;
 
     // File I/O
-    void saveToFile(ofstream& outFile) const;
+    void saveToFile(ostream& outFile) const;
     static Book loadFromFile(ifstream& inFile);
 };
 
@@ -93,125 +393,112 @@ protected:
     string name;
     string email;
     string password;
-    string role;
+    UserRole role;
 
 public:
     // Constructors
     User();
-    User(int id, const string& name, const string& email, const string& password, const string& role);
+    User(int id, const string& name, const string& email, const string& password, UserRole role);
 
     // Getters
     int getId() const;
     string getName() const;
     string getEmail() const;
     string getPassword() const;
-    string getRole() const;
+    UserRole getRole() const;
+    string getRoleName() const;
 
     // Setters
     void setId(int id);
     void setName(const string& name);
     void setEmail(const string& email);
     void setPassword(const string& password);
-    void setRole(const string& role);
+    void setRole(UserRole role);
 
     // Display user details
-    virtual void displayDetails() const;
-
-    // Virtual functions for borrowing and returning books
-    virtual bool borrowBook(Book& book, time_t currentDate) = 0;
-    virtual bool returnBook(Book& book, time_t currentDate) = 0;
+    void displayDetails() const;
 
-    // File I/O
-    virtual void saveToFile(ofstream& outFile) const;
-    static User* loadFromFile(ifstream& inFile);
+    // Borrow or return one copy of a book by the rules of the user's role
+    // (rolePolicy()). returnBook() returns true if a fine is due.
+    bool borrowBook(BookCopy& copy, time_t currentDate);
+    bool returnBook(BookCopy& copy, time_t currentDate);
 
-    // Virtual destructor for proper cleanup of derived classes
-    virtual ~User() {}
+    // File I/O. loadFromFile() returns false on an unknown role.
+    void saveToFile(ostream& outFile) const;
+    static bool loadFromFile(ifstream& inFile, User& user);
 };
 
-// Student class derived from User
-class Student : public User {
+// Fixed-size chunks of default-constructed T, handed out one slot at a time.
+// Slots never move, so a T* stays valid until it is released; released slots
+// are reset and reused first.
+template <typename T>
+class ObjectPool {
 private:
-    static const int MAX_BOOKS = 3;
-    static const int BORROW_PERIOD = 15 * 60; // 15 minutes in seconds for testing
-    static const int FINE_RATE = 10; // rupees per day
+    static const size_t CHUNK = 1024;
+    vector<unique_ptr<T[]>> chunks;
+    vector<T*> freeSlots;
+    size_t used = 0; // slots handed out from the chunks so far, released or not
 
 public:
-    // Constructors
-    Student();
-    Student(int id, const string& name, const string& email, const string& password);
-
-    // Override borrowBook and returnBook functions
-    bool borrowBook(Book& book, time_t currentDate) override;
-    bool returnBook(Book& book, time_t currentDate) override;
-
-    // Get borrow period in seconds
-    static int getBorrowPeriod();
-
-    // Get fine rate in rupees per day
-    static int getFineRate();
-
-    // Get maximum number of books that can be borrowed
-    static int getMaxBooks();
-
-    // File I/O
-    void saveToFile(ofstream& outFile) const override;
-    static Student* loadFromFile(ifstream& inFile);
+    T* acquire() {
+        if (!freeSlots.empty()) {
+            T* slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (used == chunks.size() * CHUNK) chunks.emplace_back(new T[CHUNK]);
+        T* slot = &chunks[used / CHUNK][used % CHUNK];
+        ++used;
+        return slot;
+    }
+    void release(T* slot) {
+        *slot = T();
+        freeSlots.push_back(slot);
+    }
+    void clear() {
+        chunks.clear();
+        freeSlots.clear();
+        used = 0;
+    }
 };
 
-// Faculty class derived from User
-class Faculty : public User {
+// The library's users, stored by value in one pool per role and indexed by ID.
+// The User pointers handed out stay valid until that user is erased or the
+// table cleared, and loading n users takes n / 1024 allocations per role
+// (besides long strings). Iteration and inKeyOrder() are those of the index,
+// so entries are (ID, User*) pairs.
+class UserTable {
 private:
-    static const int MAX_BOOKS = 5;
-    static const int BORROW_PERIOD = 30 * 60; // 30 minutes in seconds for testing
-    static const int MAX_OVERDUE_DAYS = 60; // 60 minutes for testing
-
-public:
-    // Constructors
-    Faculty();
-    Faculty(int id, const string& name, const string& email, const string& password);
-
-    // Override borrowBook and returnBook functions
-    bool borrowBook(Book& book, time_t currentDate) override;
-    bool returnBook(Book& book, time_t currentDate) override;
+    vector<ObjectPool<User>> pools; // indexed by UserRole, grown as roles appear
+    FlatHashMap<int, User*> index;
 
-    // Get borrow period in seconds
-    static int getBorrowPeriod();
+    ObjectPool<User>& poolOf(UserRole role);
 
-    // Get maximum number of books that can be borrowed
-    static int getMaxBooks();
-
-    // Get maximum overdue days
-    static int getMaxOverdueDays();
-
-    // File I/O
-    void saveToFile(ofstream& outFile) const override;
-    static Faculty* loadFromFile(ifstream& inFile);
-
-};
-
-// Librarian class derived from User
-class Librarian : public User {
 public:
-    // Constructors
-    Librarian();
-    Librarian(int id, const string& name, const string& email, const string& password);
+    using Entry = FlatHashMap<int, User*>::Entry;
+    using const_iterator = FlatHashMap<int, User*>::const_iterator;
 
-    // Override borrowBook and returnBook functions (Librarians cannot borrow books)
-    bool borrowBook(Book& book, time_t currentDate) override;
-    bool returnBook(Book& book, time_t currentDate) override;
+    const_iterator begin() const { return index.begin(); }
+    const_iterator end() const { return index.end(); }
+    size_t size() const { return index.size(); }
+    vector<const Entry*> inKeyOrder() const { return index.inKeyOrder(); }
 
-    // File I/O
-    void saveToFile(ofstream& outFile) const override;
-    static Librarian* loadFromFile(ifstream& inFile);
+    // Store user in its role's pool, replacing any user with its ID
+    User* add(User user);
+    // nullptr if there is no user with that ID
+    User* find(int id) const;
+    bool erase(int id);
+    void reserve(size_t count) { index.reserve(count); }
+    void clear();
 };
 
 // Account class to track user activity
 class Account {
 private:
     int userId;
-    vector<string> borrowedBooks; // ISBNs of currently borrowed books
-    vector<string> borrowHistory; // ISBNs of previously borrowed books
+    vector<CopyId> borrowedBooks; // currently borrowed copies
+    BookBitmap borrowHistory;     // every book ever borrowed
+    vector<pair<CopyId, time_t>> fineLedger; // loans already fined, and up to when
     double fines;
     bool hasPaidFines;
     
@@ -222,44 +509,495 @@ private:
 
     // Getters
     int getUserId() const;
-    vector<string> getBorrowedBooks() const;
-    vector<string> getBorrowHistory() const;
+    const vector<CopyId>& getBorrowedBooks() const;
+    const BookBitmap& getBorrowHistory() const;
     double getFines() const;
     bool getHasPaidFines() const;
 
     // Setters
     void setUserId(int userId);
-    void setBorrowedBooks(const vector<string>& books);
-    void setBorrowHistory(const vector<string>& history);
+    void setBorrowedBooks(const vector<CopyId>& copies);
+    void setBorrowHistory(const BookBitmap& history);
     void setFines(double fines);
     void setHasPaidFines(bool paid);
 
     // Account operations
-    void addBorrowedBook(const string& ISBN);
-    void removeBorrowedBook(const string& ISBN);
-    void addToBorrowHistory(const string& ISBN);
+    void addBorrowedBook(CopyId copy);
+    void removeBorrowedBook(CopyId copy);
+    bool findLoan(BookId book, CopyId& copy) const; // the borrowed copy of book, if any
+    void addToBorrowHistory(BookId book);
     void addFine(double amount);
     void payFines();
 
+    // Fine ledger: the time up to which overdue fines were charged for a
+    // current loan (0 if none yet). Returning the book drops its entry.
+    time_t getAccruedUntil(CopyId copy) const;
+    void setAccruedUntil(CopyId copy, time_t date);
+    const vector<pair<CopyId, time_t>>& getFineLedger() const;
+
     // Display account details
     void displayDetails() const;
-    void displayBorrowedBooks(const map<string, Book>& books) const;
-    void displayBorrowHistory(const map<string, Book>& books) const;
 
-    // File I/O
-    void saveToFile(ofstream& outFile) const;
-    static Account loadFromFile(ifstream& inFile);
+    // File I/O: the text files list ISBNs, translated through bookIds. A
+    // current loan is written as "<ISBN>#<copy>", followed by
+    // "\t<accruedUntil>" if it has a ledger entry. TextLoader reads them back;
+    // a loan without "#<copy>" is of the first copy.
+    void saveToFile(ostream& outFile, const BookIdTable& bookIds) const;
+};
+
+// A snapshot serialized by Snapshot::captureCatalog() and captureLoans(): the
+// sections of the file in order
+struct SnapshotImage {
+    vector<string> sections;
+};
+
+// Make tempPath durable and rename it to path, so that after a crash path
+// holds either its old or its complete new contents. Returns false on I/O error.
+bool replaceFile(const string& tempPath, const string& path);
+
+// Snapshot class to store the whole library in one binary file.
+// Layout: header, the BookId table (ISBN key per ID), fixed-size
+// book/copy/user/account records (each book points to a run of copy
+// records), an array of CopyIds for current loans, the
+// accrual time of each of those loans (fine ledger), the hold queues as
+// (book, user) pairs in queue order, the serialized history bitmaps, and a
+// string heap that all records point into.
+// The file is memory-mapped when read, so loading needs no text parsing.
+// The header also records the sequence number of the last journal entry it contains.
+class Snapshot {
+public:
+    static const uint32_t VERSION = 8;
+
+    // Serialize the library in memory in two steps, so that loans only have
+    // to be stopped for the second: captureCatalog() takes the book details
+    // and users, captureLoans() then adds the copies, accounts and hold
+    // queues and completes the image. The caller keeps what each step reads
+    // from changing until it returns, and the books and users until both have;
+    // the image can then be written without holding any lock.
+    static SnapshotImage captureCatalog(const BookIdTable& bookIds, const BookTable& books,
+                                        const UserTable& users);
+    static void captureLoans(SnapshotImage& image, const BookTable& books, const AccountTable& accounts,
+                             const HoldQueues& holdQueues, uint64_t journalSeq);
+    // Write image to path through path.tmp and replaceFile(). Returns false
+    // on I/O error, leaving the previous file in place.
+    static bool writeImage(const string& path, const SnapshotImage& image);
+
+    // Read a snapshot written by writeImage(). Returns false if the file is missing,
+    // truncated, of another version or otherwise invalid; the tables are left empty then.
+    static bool read(const string& path, BookIdTable& bookIds, BookTable& books,
+                     UserTable& users, AccountTable& accounts,
+                     HoldQueues& holdQueues, uint64_t& journalSeq);
+};
+
+// Rows read from a CSV import; line is the row's line in the file
+struct CsvBook {
+    size_t line;
+    uint64_t key; // ISBN key
+    Book book;
+};
+struct CsvUser {
+    size_t line;
+    User user;
+};
+template <typename T>
+struct CsvRows {
+    vector<T> rows;        // the valid rows, in file order
+    size_t read = 0;       // rows in the file, without the header and blank lines
+    size_t rejected = 0;
+    vector<string> errors; // "<file>:<line>: <problem>" for the first rejected rows
+};
+
+// Bulk loader for the text format (books.txt, users.txt, accounts.txt and the
+// optional copies.txt and reservations.txt). Each
+// file is read into memory in one go and parsed over string_views with
+// from_chars. Books, users and the rest are parsed on separate threads, and books.txt
+// and users.txt (fixed-size records) are also split into chunks of whole
+// records that are parsed in parallel. ISBNs are interned afterwards in file
+// order, so the BookIds are the same as with a sequential load.
+// books.txt holds one record per title ending in its number of copies, and
+// copies.txt one line per copy that is not Available. The older books.txt
+// with the status, borrower and dates of a single copy is still read.
+class TextLoader {
+public:
+    // Load the files found in dir into the (empty) tables. Malformed records
+    // are skipped and described in errors as "<file>:<line>: <problem>", as
+    // are missing files. For duplicate keys the last record wins.
+    static void load(const string& dir, BookIdTable& bookIds, BookTable& books,
+                     UserTable& users, AccountTable& accounts, HoldQueues& holdQueues,
+                     vector<string>& errors);
+
+    // Read a CSV file for a bulk import, parsed in parallel chunks like the
+    // text files: books as title,author,publisher,year,ISBN[,copies] and users
+    // as role,id,name,email,password, one per line after an optional header
+    // line (starting with "title" or "role"). Fields can be quoted to hold
+    // commas but cannot span lines. Malformed rows, and rows repeating an ISBN
+    // or user ID of an earlier row, are rejected. Returns false if the file
+    // cannot be read.
+    static bool loadBookCsv(const string& path, CsvRows<CsvBook>& result);
+    static bool loadUserCsv(const string& path, CsvRows<CsvUser>& result);
+};
+
+// One journal record: its sequence number, the operation name and its arguments
+struct JournalEntry {
+    uint64_t seq;
+    vector<string> fields; // fields[0] is the operation
+};
+
+// Append-only operation journal (journal.log). Every state change made through
+// the Library API is appended as one tab-separated line and replayed on top of
+// the last snapshot at startup; saveData() compacts it into a new snapshot.
+class Journal {
+private:
+    string path;
+    ofstream outFile;
+    uint64_t nextSeq;
+    size_t pendingEntries; // entries written since the last checkpoint
+
+    static vector<JournalEntry> readFile(const string& path);
+
+public:
+    static const size_t COMPACT_THRESHOLD = 1000;
+
+    // Constructors
+    Journal();
+
+    // Read all complete entries from path, after those of its rotated file
+    // if one is left; a torn last line (crash while appending) is cut off so
+    // that new entries start on a clean line.
+    static vector<JournalEntry> readEntries(const string& path);
+    static string rotatedPath(const string& path);
+
+    // Open path for appending; sequence numbers continue after lastSeq
+    bool open(const string& path, uint64_t lastSeq, size_t pendingEntries);
+    bool isOpen() const;
+
+    // Append one operation and flush it to the operating system (it is not
+    // fsynced). Returns false on I/O error.
+    bool append(const vector<string>& fields);
+    // Append several operations with one write, e.g. for a bulk import
+    bool appendAll(const vector<vector<string>>& entries);
+
+    // Checkpoints: rotate() when the snapshot is taken, so later entries go
+    // to a fresh file, and dropRotated() once the snapshot is on disk.
+    // rotate() returns false if the entries could not be moved aside.
+    bool rotate();
+    void dropRotated();
+
+    uint64_t getLastSeq() const;
+    bool needsCompaction() const;
+    bool hasPendingEntries() const; // entries not in a snapshot yet
+};
+
+// Inverted index from lower-cased words of title, author and ISBN to the
+// sorted IDs of the books containing them. Answers multi-word AND queries
+// in time proportional to the posting lists involved, not the catalog size.
+class TokenIndex {
+private:
+    unordered_map<string, vector<BookId>> postings; // term -> sorted IDs
+
+public:
+    // Split text into lower-case runs of letters and digits
+    static vector<string> tokenize(const string& text);
+
+    void addBook(BookId id, const Book& book);
+    void removeBook(BookId id, const Book& book);
+    void clear();
+
+    // Rebuild the whole index at once (sorts every posting list a single time)
+    void build(const BookTable& books);
+
+    // IDs of books containing every term, in ID order
+    vector<BookId> query(const vector<string>& terms) const;
+};
+
+// Trigram index over title, author and ISBN: maps every 3-byte substring to
+// the sorted IDs of the books containing it. A substring query can only match books that
+// contain all of its trigrams, which narrows the candidates to verify.
+class TrigramIndex {
+private:
+    unordered_map<uint32_t, vector<BookId>> postings; // trigram -> sorted IDs
+
+public:
+    // Distinct trigrams of text, packed into the low 24 bits
+    static vector<uint32_t> trigrams(const string& text);
+
+    void addBook(BookId id, const Book& book);
+    void removeBook(BookId id, const Book& book);
+    void clear();
+    void build(const BookTable& books);
+
+    // Sorted IDs of books that may contain keyword (keyword must be >= 3 bytes)
+    vector<BookId> candidates(const string& keyword) const;
+};
+
+// Orders a catalog listing can be sorted in; DueDate lists only the books on loan
+enum class BookOrder : uint8_t { ISBN = 0, Title = 1, Author = 2, Publisher = 3, Year = 4, DueDate = 5 };
+
+string bookOrderName(BookOrder order);                     // "ISBN", "title", ...
+bool bookOrderFromName(const string& name, BookOrder& order); // case-insensitive, "due" for DueDate
+
+// The catalog sorted by ISBN, title, author, publisher and year, each kept as
+// a vector of BookIds (ties broken by ISBN). The vectors are updated on every
+// catalog change, so a page of a listing is a slice instead of a sort of the
+// catalog, and the books with a given author or publisher, or from a range of
+// years, are found by binary search.
+class CatalogOrder {
+private:
+    static const size_t ORDERS = 5; // ISBN .. Year
+    const BookTable& books;
+    const BookIdTable& bookIds;
+    array<vector<BookId>, ORDERS> sorted;
+
+    bool less(size_t order, const Book& a, BookId idA, const Book& b, BookId idB) const;
+
+public:
+    CatalogOrder(const BookTable& books, const BookIdTable& bookIds);
+
+    // addBook takes the book before it is in the orders, removeBook the
+    // book as it was added (books may hold it or not).
+    void addBook(BookId id, const Book& book);
+    void removeBook(BookId id, const Book& book);
+    // Bulk add of books that are already in books: sorted on their own and
+    // merged in, one pass over each order
+    void addBooks(vector<BookId> added);
+    void clear();
+    void build();
+
+    // The sorted IDs; order must not be DueDate
+    const vector<BookId>& ids(BookOrder order) const;
+
+    // Positions [first, last) in ids(Author/Publisher) of the books with
+    // exactly this author/publisher, and in ids(Year) of the years [from, to]
+    pair<size_t, size_t> equalRange(BookOrder order, const string& value) const;
+    pair<size_t, size_t> yearRange(int fromYear, int toYear) const;
+};
+
+// Read-copy-update versions of the state of every book's copies, so readers
+// never wait for loans. A writer publishes a book's copies after changing
+// them (under the book's stripe); every publish is a commit with the next
+// sequence number. A reader opens a View, which fixes the last commit, and
+// sees each book as of that commit: the newest version at or before it.
+// Each book's versions form a chain from the newest; a publish keeps the
+// older ones only as far back as the oldest open View needs.
+// Books are only added or removed under the exclusive catalog lock, when no
+// View is open, so the chains only ever change by publish().
+class CatalogVersions {
+public:
+    struct Version {
+        uint64_t seq;
+        vector<BookCopy> copies;
+        mutable shared_ptr<const Version> older; // atomic_load/atomic_store only
+    };
+
+    // A consistent point in time for reading; closed when it goes out of scope
+    class View {
+    private:
+        const CatalogVersions& versions;
+        uint64_t seq;
+
+    public:
+        explicit View(const CatalogVersions& versions);
+        ~View();
+        View(const View&) = delete;
+        View& operator=(const View&) = delete;
+        uint64_t getSeq() const { return seq; }
+        // The book's version as of this view, nullptr if it has none
+        shared_ptr<const Version> find(BookId id) const;
+    };
+
+    void publish(BookId id, const vector<BookCopy>& copies);
+    void erase(BookId id);     // no View may be open
+    void clear();              // no View may be open
+    shared_ptr<const Version> newest(BookId id) const;
+
+private:
+    vector<shared_ptr<const Version>> heads; // by BookId, atomic_load/atomic_store only
+    mutable mutex commitMutex;               // orders commits; guards lastSeq and openViews
+    uint64_t lastSeq = 0;
+    mutable multiset<uint64_t> openViews;
+};
+
+// One page of a catalog listing
+struct BookPage {
+    BookOrder order;
+    size_t offset;      // position of books[0] in the whole listing
+    size_t total;       // number of books in the whole listing
+    vector<Book> books;
+};
+
+// Operations whose latency is measured, and their names in the reports
+// (CheckpointPause is the part of saveData during which the library is locked)
+enum class Operation : uint8_t { Borrow, Return, Search, Login, LoadData, SaveData, CheckpointPause, CalculateFines };
+const size_t OPERATION_COUNT = 8;
+string operationName(Operation op);
+
+// Log-linear latency histogram in nanoseconds: every power of two is split
+// into SUB_BUCKETS buckets, so a percentile is off by at most 1/SUB_BUCKETS.
+// record() is a few relaxed atomic adds and may be called from any thread;
+// the readers see a consistent enough picture for a report.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t nanos, bool failed);
+    uint64_t getCount() const { return count.load(memory_order_relaxed); }
+    uint64_t getFailed() const { return failed.load(memory_order_relaxed); }
+    uint64_t getTotal() const { return total.load(memory_order_relaxed); }
+    uint64_t getMax() const { return maximum.load(memory_order_relaxed); }
+    // Upper bound of the bucket holding the given fraction (0..1) of the values
+    uint64_t percentile(double fraction) const;
+    // Non-empty buckets as (upper bound, count), smallest first
+    vector<pair<uint64_t, uint64_t>> nonEmptyBuckets() const;
+
+    static int bucketOf(uint64_t nanos);
+    static uint64_t bucketUpperBound(int bucket);
+
+private:
+    array<atomic<uint64_t>, BUCKETS> buckets{};
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> failed{0};
+    atomic<uint64_t> total{0};
+    atomic<uint64_t> maximum{0};
+};
+
+// One histogram per Operation; counts include refused operations, which are
+// also counted as failed.
+class Metrics {
+private:
+    array<LatencyHistogram, OPERATION_COUNT> histograms;
+
+public:
+    void record(Operation op, uint64_t nanos, bool failed) {
+        histograms[static_cast<size_t>(op)].record(nanos, failed);
+    }
+    const LatencyHistogram& of(Operation op) const { return histograms[static_cast<size_t>(op)]; }
+    // Table with count, failures, p50/p99/max and mean per operation
+    void report(ostream& out) const;
+    // Tab-separated, one line per operation with the raw bucket counts
+    bool writeFile(const string& path) const;
+};
+
+// Times a scope and records it on destruction. Operations that return a
+// result pass it through finish() so refusals are counted as failures.
+class OperationTimer {
+private:
+    Metrics& metrics;
+    Operation op;
+    chrono::steady_clock::time_point start;
+    bool failed = false;
+
+public:
+    OperationTimer(Metrics& metrics, Operation op)
+        : metrics(metrics), op(op), start(chrono::steady_clock::now()) {}
+    ~OperationTimer() {
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+        metrics.record(op, static_cast<uint64_t>(elapsed.count()), failed);
+    }
+    bool finish(bool ok) {
+        failed = !ok;
+        return ok;
+    }
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+};
+
+// Reports that can be exported to a file, and the formats they come in
+enum class Report : uint8_t { Overdue, Fines, Circulation, Activity };
+enum class ReportFormat : uint8_t { CSV, JSON };
+
+bool reportFromName(const string& name, Report& report);             // "overdue", "fines", ...
+bool reportFormatFromName(const string& name, ReportFormat& format); // "csv" or "json", any case
+
+// Writes a report one row at a time as CSV (a header line, then one line per
+// row) or JSON (an array with one object per row, one per line). Rows go
+// through a fixed-size buffer, so a report of any length needs one row of
+// memory. The file is written to <path>.tmp, which replaces path in finish().
+class ReportWriter {
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    string path;
+    ofstream out;
+    ReportFormat format;
+    vector<string> columns;
+    string buffer;
+    size_t column = 0; // of the next field in the current row
+    size_t rows = 0;
+
+    void beginField();
+    void flush();
+
+public:
+    ReportWriter(const string& path, ReportFormat format, vector<string> columns);
+    bool isOpen() const { return static_cast<bool>(out); }
+
+    // The fields of a row, in column order, then endRow()
+    void text(string_view value);
+    void number(long long value);
+    void number(double value);
+    void date(time_t value); // ISO 8601 UTC, e.g. 2024-03-01T09:30:00Z
+    void endRow();
+
+    size_t getRows() const { return rows; }
+    // Close the file and move it into place; false on any I/O error
+    bool finish();
 };
 
 // Library class to manage the entire system
+/*
+Concurrency: borrowBook, returnBook, settleFines, searchBooks and the reports
+may be called from several threads (one per circulation desk).
+• Searches and listings take no stripe lock: they read the copies of each
+  book from a CatalogVersions::View, so they see one point in time and loans
+  never wait for them.
+• catalogMutex is held shared by those operations and exclusively while books
+  or users are added, updated or removed, and while a snapshot is written.
+• Loans are protected by striped locks: one stripe per account (by user ID)
+  and per book (by BookId). Lock order is always: catalogMutex, one account
+  stripe, book stripes in ascending stripe order, dueMutex, journalMutex.
+• dueMutex guards the due-date and hold indexes and the hold queues.
+• Title, author and ISBN only change under the exclusive catalog lock, so
+  searches read them without any stripe lock.
+The menus in run() and findBook/findUser/findAccount do not lock.
+*/
 class Library{
 
 private:
-    map<int, User*> users;
-    map<string, Book> books;
-    map<int, Account> accounts;
+    static const size_t LOCK_STRIPES = 64;
+
+    UserTable users;
+    BookIdTable bookIds;  // ISBN <-> BookId
+    BookTable books;
+    AccountTable accounts;
     int currentUserId;
     string dataDirectory;
+    Journal journal;
+    TokenIndex searchIndex;
+    TrigramIndex trigramIndex;
+    CatalogOrder catalogOrder;
+    set<pair<time_t, CopyId>> dueIndex; // (due date, copy) of every borrowed copy, earliest first
+    set<pair<time_t, CopyId>> holdIndex; // (hold expiry, copy) of every reserved copy, earliest first
+    HoldQueues holdQueues;
+    mutable Metrics metrics;
+    // Background checkpoints: checkpointThread runs saveData() every
+    // CHECKPOINT_INTERVAL while there are journal entries, and when
+    // compactIfNeeded() asks for it; saveMutex lets one checkpoint run at a time
+    thread checkpointThread;
+    mutex checkpointMutex;
+    condition_variable checkpointWake;
+    bool checkpointRequested = false;
+    bool stopCheckpoints = false;
+    mutex saveMutex;
+    uint64_t catalogChanges = 0; // bumped under the exclusive catalogMutex whenever books or users change
+    mutable CatalogVersions versions; // what readers see of the copies
+    string metricsPath; // written on exit when set
+
+    mutable shared_mutex catalogMutex;
+    mutable array<mutex, LOCK_STRIPES> accountLocks;
+    mutable array<mutex, LOCK_STRIPES> bookLocks;
+    mutable mutex dueMutex;
+    mutable mutex journalMutex;
 
     // CLI helper methods
     void clearScreen();
@@ -278,10 +1016,55 @@ private:
     void processLibrarianBooksMenuChoice(const string& choice);
     void processLibrarianUsersMenuChoice(const string& choice);
     void processLibrarianReportsMenuChoice(const string& choice);
+    void displaySearchResults(const string& query) const;
     // Helper methods
     void addInitialData();
-    void saveData();
     void loadData();
+    bool importTextData(const string& dir);
+    string snapshotPath() const;
+    string journalPath() const;
+    // Catalog helpers: insert/erase a book and keep the indexes up to date
+    bool putBook(const Book& book);
+    void eraseBook(BookId id);
+    void rebuildIndexes();
+    void trackLoan(CopyId copy, const BookCopy& state);
+    void untrackLoan(CopyId copy, const BookCopy& state);
+    bool findBookId(const string& ISBN, BookId& id) const;
+    Book* bookById(BookId id);
+    const Book* bookById(BookId id) const;
+    void sortByISBN(vector<BookId>& ids) const;
+    // Locking helpers
+    mutex& accountLock(int userId) const;
+    mutex& bookLock(BookId id) const;
+    vector<unique_lock<mutex>> lockBooks(vector<BookId> ids) const;
+    // Snapshot reads: writers publish a book's copies after changing them,
+    // readers copy books as of their View
+    void publishCopies(BookId id, const Book& book);
+    void publishAll();
+    Book viewCopy(const CatalogVersions::View& view, BookId id, const Book& book) const;
+    vector<Book> copyRange(BookOrder order, pair<size_t, size_t> range) const;
+    vector<pair<time_t, CopyId>> overdueLoans(time_t currentDate, const pair<time_t, CopyId>* after = nullptr,
+                                              size_t limit = SIZE_MAX) const;
+    bool findHeldCopy(const Book& book, int userId, uint32_t& copy) const;
+    void handOff(CopyId copy, Book& book, time_t currentDate);
+    uint32_t handOffNewCopies(BookId id, uint32_t firstNew);
+    void releaseHold(CopyId copy, Book& book);
+    void borrowOrReserve(const string& ISBN);
+    int accrueFine(int userId, Account& account, CopyId copy, const Book& book, int fineRate, time_t currentDate);
+    bool doBorrowBook(int userId, BookId id);
+    bool doReturnBook(int userId, BookId id);
+    void checkpointLoop();
+    // Report export: write the rows of one report, under the shared catalog lock
+    void reportOverdue(ReportWriter& writer, time_t currentDate) const;
+    void reportFines(ReportWriter& writer) const;
+    void reportCirculation(ReportWriter& writer) const;
+    void reportActivity(ReportWriter& writer, time_t currentDate) const;
+    // Journal helpers: record an operation (or several), and apply a recorded one on load
+    void logOperation(const vector<string>& fields);
+    void logOperations(const vector<vector<string>>& entries);
+    void compactIfNeeded();
+    void replayJournal(uint64_t snapshotSeq);
+    bool applyJournalEntry(const JournalEntry& entry);
     time_t getCurrentDate() const;
     string formatDate(time_t date) const;
     int calculateOverdueDays(time_t dueDate, time_t currentDate) const;
@@ -291,19 +1074,40 @@ public:
     Library(const string& dataDir = "data");
     ~Library();
 
-    // Library management
-    void addBook(const Book& book);
-    void removeBook(const string& ISBN);
-    void updateBook(const Book& book);
-    void displayAllBooks() const;
+    // Library management (return false when the operation was refused).
+    // Adding a book that is already in the catalog adds its copies to it;
+    // updating one sets its details and number of copies (copies can only be
+    // dropped from the end, and only while they are Available).
+    bool addBook(const Book& book);
+    bool removeBook(const string& ISBN);
+    bool updateBook(const Book& book);
+    void displayAllBooks() const; // interactive, one page at a time
     void searchBooks(const string& keyword) const;
+    void searchBooksByWords(const string& words) const;
+    // Catalog listing in pages: copies of up to limit books from offset on
+    BookPage listBooks(BookOrder order, size_t offset, size_t limit) const;
+    // Secondary index lookups: exact author or publisher, or year in
+    // [fromYear, toYear]. Copies, ordered by that field and then by ISBN.
+    vector<Book> booksByAuthor(const string& author) const;
+    vector<Book> booksByPublisher(const string& publisher) const;
+    vector<Book> booksByYear(int fromYear, int toYear) const;
+    static void displayBookPage(const BookPage& page);
 
-    // User management
-    void addUser(User* user);
-    void removeUser(int userId);
+    // Bulk import from a CSV file (see TextLoader::loadBookCsv), for
+    // librarians. Rows whose ISBN is already cataloged or whose user ID is
+    // taken are rejected as well. The file is parsed before the catalog is
+    // locked. Prints the number of rows imported and rejected, the rows per
+    // second and the first problems.
+    bool importBooksCsv(const string& path);
+    bool importUsersCsv(const string& path);
+
+    // User management (addUser stores a copy of user)
+    bool addUser(const User& user);
+    bool removeUser(int userId);
     void displayAllUsers() const;
     User* findUser(int userId) const;
-    Book* findBook(const string& ISBN);
+    Book* findBook(const string& ISBN);             // any ISBN-10/13 spelling
+    const Book* findBook(const string& ISBN) const;
     Account* findAccount(int userId);
 
     // Book operations
@@ -312,6 +1116,28 @@ public:
     void checkOverdueBooks();
     void calculateFines();
 
+    // Stream a report to a file as CSV or JSON, for librarians:
+    //   overdue      every overdue loan, most overdue first
+    //   fines        users with outstanding fines (charged up to now first)
+    //   circulation  every title by ISBN: copies on loan and on hold, waitlist
+    //                length and how many users have ever borrowed it
+    //   activity     every user: current loans, how many are overdue, titles
+    //                ever borrowed and outstanding fines
+    // Users are listed in no particular order. Loans and returns go on while
+    // the report is written. Prints the number of rows and the time taken.
+    bool exportReport(Report report, const string& path, ReportFormat format);
+
+    // Reservations: a user joins a book's waitlist while all its copies are
+    // out. When a copy comes back it is Reserved for the first user in line
+    // (borrowerId is that user, dueDate the end of the hold) until they borrow
+    // it or the hold expires, in which case it passes to the next user.
+    static const time_t HOLD_PERIOD = 3 * 60;  // 3 days (1 minute = 1 day)
+    bool reserveBook(int userId, const string& ISBN);
+    bool cancelReservation(int userId, const string& ISBN);
+    void expireHolds();                                // passes on or releases the expired holds
+    vector<int> waitlistOf(const string& ISBN) const;  // user IDs, first in line first
+    vector<string> holdsFor(int userId) const;         // ISBNs reserved for the user, ready to borrow
+
     // Authentication
     bool login(int userId, const string& password);
     void logout();
@@ -320,7 +1146,34 @@ public:
 
     // Account operations
     void displayUserAccount() const; // Remove userId parameter
-    void settleFines(int userId);
+    bool settleFines(int userId);
+
+    // Borrow history queries, answered from the per-account history bitmaps
+    bool hasBorrowed(int userId, const string& ISBN) const;
+    vector<int> borrowersOf(const string& ISBN) const;          // user IDs, ascending
+    vector<string> commonHistory(int userA, int userB) const;   // ISBNs both have borrowed
+
+    // Checkpoint the library into a new snapshot, now. The library is locked
+    // only while it is serialized in memory; the file is written after that
+    // and replaces the old one atomically. A background thread also does this
+    // periodically, and it is done on exit.
+    static const int CHECKPOINT_INTERVAL = 60; // seconds
+    void saveData();
+
+    // Latency and counts of the main operations since the library was opened
+    void displayPerformanceReport() const;
+    const Metrics& getMetrics() const { return metrics; }
+    void setMetricsFile(const string& path) { metricsPath = path; } // dumped on exit
+
+    // Text format export (books.txt, users.txt, accounts.txt and the optional
+    // files), written on three threads; each file replaces the old one
+    // atomically. Takes a checkpoint first, so the journal restarts after it.
+    bool exportTextData(const string& dir);
+
+    // Check that books, accounts and the due-date index agree with each other
+    // (each borrowed book is listed by exactly its borrower's account, ...).
+    // Problems are described on out; returns how many were found.
+    size_t verifyConsistency(ostream& out) const;
 
     // Run the library system
     void run();
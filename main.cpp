@@ -1,6 +1,7 @@
 #include "lms.h"
 #include <iostream>
 #include <string>
+#include <chrono>
 
 /*
 In the main code() first build the library with at least 10 books, 5 students , 3 faculty and 1 librarian.
@@ -10,8 +11,326 @@ The classes suggested here are just exemplary. Feel free to be a bit creative by
 members or member functions such that the system is implemented in a more efficient way.
 */
 using namespace std;
-int main() {
+
+/*
+Batch mode: ./lily.exe [--metrics <file>] --batch <file>   (use "-" to read from stdin)
+One command per line; blank lines and lines starting with '#' are skipped.
+    login <userId> <password>
+    logout
+    borrow [<userId>] <ISBN>          (default: the logged-in user)
+    return [<userId>] <ISBN>          (default: the borrower of a single-copy book)
+    reserve [<userId>] <ISBN>         (join the waitlist of a book that is out)
+    cancel-reservation [<userId>] <ISBN>
+    waitlist <ISBN>                   (user IDs, first in line first)
+    expire-holds
+    add-book <title>|<author>|<publisher>|<year>|<ISBN>[|<copies>]   (adds copies to a cataloged book)
+    remove-book <ISBN>
+    add-user <student|faculty|librarian>|<id>|<name>|<email>|<password>
+    remove-user <userId>
+    import-books <file>               (CSV: title,author,publisher,year,ISBN[,copies])
+    import-users <file>               (CSV: role,id,name,email,password)
+    settle-fines <userId>
+    calculate-fines
+    overdue
+    export-report <overdue|fines|circulation|activity> <csv|json> <file>
+    search <keyword>
+    search-words <word>...            (books having every word in title, author or ISBN)
+    list [isbn|title|author|publisher|year|due] [<page>]   (20 books per page, default: by ISBN, page 1)
+    by-author <name>                  (exact author, via the secondary indexes)
+    by-publisher <name>
+    by-year <from> [<to>]
+    borrowers <ISBN>                  (users who have ever borrowed the book)
+    common-history <userId> <userId>  (books both users have borrowed)
+    metrics                           (latency report of the main operations)
+    save
+Every command prints "<line>\t<OK|FAIL>\t<command>\t<messages>", followed by a
+summary with the total throughput.
+*/
+
+// Split on sep, keeping empty fields
+static vector<string> splitFields(const string& text, char sep) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find(sep, start);
+        fields.push_back(text.substr(start, end - start));
+        if (end == string::npos) break;
+        start = end + 1;
+    }
+    return fields;
+}
+
+static bool parseInt(const string& text, int& value) {
+    try {
+        size_t used = 0;
+        value = stoi(text, &used);
+        return used == text.size();
+    } catch (const exception&) {
+        return false;
+    }
+}
+
+static bool requireLogin(Library& library) {
+    if (library.isLoggedIn()) return true;
+    cout << "Please log in first.\n";
+    return false;
+}
+
+// Circulation for another user's account is left to librarians
+static bool mayActFor(Library& library, int userId) {
+    if (!requireLogin(library)) return false;
+    const User* user = library.getCurrentUser();
+    if (user->getId() == userId || rolePolicy(user->getRole()).manages) return true;
+    cout << "Access denied. You can only act for your own account.\n";
+    return false;
+}
+
+// Run one command; messages printed by the Library end up in the captured output.
+static bool runCommand(Library& library, const string& command, const string& args) {
+    vector<string> words;
+    istringstream iss(args);
+    for (string word; iss >> word;) words.push_back(word);
+    int id = 0;
+
+    if (command == "login" && words.size() == 2 && parseInt(words[0], id)) {
+        return library.login(id, words[1]);
+    } else if (command == "logout" && words.empty()) {
+        library.logout();
+        return true;
+    } else if (command == "borrow" && words.size() == 1) {
+        if (!requireLogin(library)) return false;
+        return library.borrowBook(library.getCurrentUser()->getId(), words[0]);
+    } else if (command == "borrow" && words.size() == 2 && parseInt(words[0], id)) {
+        if (!mayActFor(library, id)) return false;
+        return library.borrowBook(id, words[1]);
+    } else if (command == "return" && words.size() == 1) {
+        if (!requireLogin(library)) return false;
+        Book* book = library.findBook(words[0]);
+        if (!book || book->getAvailableCount() == book->getCopyCount()) {
+            cout << "Book is not borrowed.\n";
+            return false;
+        }
+        // With several copies out the borrower cannot be guessed
+        if (book->getCopyCount() > 1) {
+            cout << "Book has several copies; usage: return <userId> <ISBN>\n";
+            return false;
+        }
+        if (book->getCopy(0).getStatus() != BookStatus::Borrowed) {
+            cout << "Book is not borrowed.\n";
+            return false;
+        }
+        id = book->getCopy(0).getBorrowerId();
+        if (!mayActFor(library, id)) return false;
+        return library.returnBook(id, words[0]);
+    } else if (command == "return" && words.size() == 2 && parseInt(words[0], id)) {
+        if (!mayActFor(library, id)) return false;
+        return library.returnBook(id, words[1]);
+    } else if ((command == "reserve" || command == "cancel-reservation") && (words.size() == 1 || words.size() == 2)) {
+        if (words.size() == 1) {
+            if (!requireLogin(library)) return false;
+            id = library.getCurrentUser()->getId();
+        } else if (!parseInt(words[0], id)) {
+            cout << "Usage: " << command << " [<userId>] <ISBN>\n";
+            return false;
+        } else if (!mayActFor(library, id)) {
+            return false;
+        }
+        return command == "reserve" ? library.reserveBook(id, words.back()) : library.cancelReservation(id, words.back());
+    } else if (command == "waitlist" && words.size() == 1) {
+        if (!library.findBook(words[0])) {
+            cout << "Book not found.\n";
+            return false;
+        }
+        vector<int> waitlist = library.waitlistOf(words[0]);
+        cout << waitlist.size() << " waiting:";
+        for (int userId : waitlist) cout << ' ' << userId;
+        cout << '\n';
+        return true;
+    } else if (command == "expire-holds" && words.empty()) {
+        if (!requireLogin(library)) return false;
+        library.expireHolds();
+        return true;
+    } else if (command == "add-book") {
+        vector<string> f = splitFields(args, '|');
+        int year = 0, copies = 1;
+        if ((f.size() != 5 && f.size() != 6) || !parseInt(f[3], year) ||
+            (f.size() == 6 && (!parseInt(f[5], copies) || copies < 1))) {
+            cout << "Usage: add-book <title>|<author>|<publisher>|<year>|<ISBN>[|<copies>]\n";
+            return false;
+        }
+        return library.addBook(Book(f[0], f[1], f[2], year, f[4], copies));
+    } else if (command == "remove-book" && words.size() == 1) {
+        return library.removeBook(words[0]);
+    } else if (command == "add-user") {
+        vector<string> f = splitFields(args, '|');
+        UserRole role;
+        if (f.size() != 5 || !userRoleFromName(f[0], role) || !parseInt(f[1], id)) {
+            cout << "Usage: add-user <student|faculty|librarian>|<id>|<name>|<email>|<password>\n";
+            return false;
+        }
+        return library.addUser(User(id, f[2], f[3], f[4], role));
+    } else if (command == "import-books" && !args.empty()) {
+        return library.importBooksCsv(args);
+    } else if (command == "import-users" && !args.empty()) {
+        return library.importUsersCsv(args);
+    } else if (command == "remove-user" && words.size() == 1 && parseInt(words[0], id)) {
+        return library.removeUser(id);
+    } else if (command == "settle-fines" && words.size() == 1 && parseInt(words[0], id)) {
+        return library.settleFines(id);
+    } else if (command == "calculate-fines" && words.empty()) {
+        if (!requireLogin(library)) return false;
+        library.calculateFines();
+        return true;
+    } else if (command == "overdue" && words.empty()) {
+        library.checkOverdueBooks();
+        return true;
+    } else if (command == "export-report") {
+        Report report;
+        ReportFormat format;
+        if (words.size() != 3 || !reportFromName(words[0], report) || !reportFormatFromName(words[1], format)) {
+            cout << "Usage: export-report <overdue|fines|circulation|activity> <csv|json> <file>\n";
+            return false;
+        }
+        return library.exportReport(report, words[2], format);
+    } else if (command == "search" && !args.empty()) {
+        library.searchBooks(args);
+        return true;
+    } else if (command == "search-words" && !args.empty()) {
+        library.searchBooksByWords(args);
+        return true;
+    } else if (command == "list" && words.size() <= 2) {
+        BookOrder order = BookOrder::ISBN;
+        int page = 1;
+        if ((!words.empty() && !bookOrderFromName(words[0], order)) ||
+            (words.size() == 2 && (!parseInt(words[1], page) || page < 1))) {
+            cout << "Usage: list [isbn|title|author|publisher|year|due] [<page>]\n";
+            return false;
+        }
+        const size_t pageSize = 20;
+        Library::displayBookPage(library.listBooks(order, (page - 1) * pageSize, pageSize));
+        return true;
+    } else if ((command == "by-author" || command == "by-publisher") && !args.empty()) {
+        vector<Book> found = command == "by-author" ? library.booksByAuthor(args) : library.booksByPublisher(args);
+        cout << found.size() << " book(s):";
+        for (const Book& book : found) cout << ' ' << book.getISBN();
+        cout << '\n';
+        return true;
+    } else if (command == "by-year" && (words.size() == 1 || words.size() == 2)) {
+        int fromYear = 0, toYear = 0;
+        if (!parseInt(words[0], fromYear) || !parseInt(words.back(), toYear)) {
+            cout << "Usage: by-year <from> [<to>]\n";
+            return false;
+        }
+        vector<Book> found = library.booksByYear(fromYear, toYear);
+        cout << found.size() << " book(s):";
+        for (const Book& book : found) cout << ' ' << book.getISBN();
+        cout << '\n';
+        return true;
+    } else if (command == "borrowers" && words.size() == 1) {
+        if (!library.findBook(words[0])) {
+            cout << "Book not found.\n";
+            return false;
+        }
+        vector<int> borrowers = library.borrowersOf(words[0]);
+        cout << borrowers.size() << " borrower(s):";
+        for (int userId : borrowers) cout << ' ' << userId;
+        cout << '\n';
+        return true;
+    } else if (command == "common-history" && words.size() == 2 && parseInt(words[0], id)) {
+        int otherId = 0;
+        if (!parseInt(words[1], otherId)) {
+            cout << "Usage: common-history <userId> <userId>\n";
+            return false;
+        }
+        if (!mayActFor(library, id) || !mayActFor(library, otherId)) return false;
+        if (!library.findAccount(id) || !library.findAccount(otherId)) {
+            cout << "Account not found.\n";
+            return false;
+        }
+        vector<string> isbns = library.commonHistory(id, otherId);
+        cout << isbns.size() << " book(s) in common:";
+        for (const string& isbn : isbns) cout << ' ' << isbn;
+        cout << '\n';
+        return true;
+    } else if (command == "metrics" && words.empty()) {
+        library.displayPerformanceReport();
+        return true;
+    } else if (command == "save" && words.empty()) {
+        library.saveData();
+        return true;
+    }
+    cout << "Unknown command or wrong arguments.\n";
+    return false;
+}
+
+static int runBatch(Library& library, istream& in) {
+    size_t lineNo = 0, ok = 0, failed = 0;
+    string line;
+    auto start = chrono::steady_clock::now();
+
+    // Library messages are captured per command instead of going to the terminal
+    ostringstream captured;
+    streambuf* coutBuf = cout.rdbuf(captured.rdbuf());
+    streambuf* cerrBuf = cerr.rdbuf(captured.rdbuf());
+    ostream report(coutBuf);
+
+    while (getline(in, line)) {
+        ++lineNo;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos || line[first] == '#') continue;
+        line = line.substr(first);
+
+        size_t space = line.find(' ');
+        string command = line.substr(0, space);
+        string args;
+        if (space != string::npos && line.find_first_not_of(' ', space) != string::npos)
+            args = line.substr(line.find_first_not_of(' ', space));
+
+        captured.str("");
+        bool success = runCommand(library, command, args);
+        success ? ++ok : ++failed;
+
+        string messages = captured.str();
+        replace(messages.begin(), messages.end(), '\n', ' ');
+        while (!messages.empty() && messages.back() == ' ') messages.pop_back();
+        report << lineNo << '\t' << (success ? "OK" : "FAIL") << '\t' << line << '\t' << messages << '\n';
+    }
+
+    cout.rdbuf(coutBuf);
+    cerr.rdbuf(cerrBuf);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t total = ok + failed;
+    cout << "Batch finished: " << total << " commands, " << ok << " OK, " << failed << " failed in "
+         << fixed << setprecision(3) << seconds << " s ("
+         << setprecision(0) << (seconds > 0 ? total / seconds : 0) << " commands/s)" << endl;
+    return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    // --metrics <file> writes the operation latencies to file on exit
+    string metricsPath;
+    if (argc >= 3 && string(argv[1]) == "--metrics") {
+        metricsPath = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc == 3 && string(argv[1]) == "--batch") {
+        string path = argv[2];
+        ifstream inFile;
+        if (path != "-") {
+            inFile.open(path);
+            if (!inFile) {
+                cerr << "Error: Unable to open " << path << endl;
+                return 2;
+            }
+        }
+        Library library;
+        library.setMetricsFile(metricsPath);
+        return runBatch(library, path == "-" ? cin : inFile);
+    }
     Library library;
+    library.setMetricsFile(metricsPath);
     library.run(); // Start interactive menu
     return 0;
 }
@@ -0,0 +1,120 @@
+#include "lms.h"
+// LatencyHistogram and Metrics class implementation
+/*
+metrics.tsv (written on exit with --metrics) has a header line and then one
+line per operation:
+    <operation>\t<count>\t<failed>\t<total ns>\t<p50 ns>\t<p99 ns>\t<max ns>\t<buckets>
+where <buckets> lists the non-empty buckets as <upper bound ns>:<count>,
+separated by commas.
+*/
+using namespace std;
+
+namespace {
+
+const Operation ALL_OPERATIONS[] = {Operation::Borrow, Operation::Return, Operation::Search, Operation::Login,
+                                    Operation::LoadData, Operation::SaveData, Operation::CheckpointPause,
+                                    Operation::CalculateFines};
+
+// 850 ns, 3.2 us, 12.4 ms, 1.20 s
+string formatNanos(uint64_t nanos) {
+    ostringstream out;
+    out << fixed;
+    if (nanos < 1000) out << nanos << " ns";
+    else if (nanos < 1000000) out << setprecision(1) << nanos / 1e3 << " us";
+    else if (nanos < 1000000000) out << setprecision(1) << nanos / 1e6 << " ms";
+    else out << setprecision(2) << nanos / 1e9 << " s";
+    return out.str();
+}
+
+} // namespace
+
+string operationName(Operation op) {
+    switch (op) {
+        case Operation::Borrow: return "borrowBook";
+        case Operation::Return: return "returnBook";
+        case Operation::Search: return "searchBooks";
+        case Operation::Login: return "login";
+        case Operation::LoadData: return "loadData";
+        case Operation::SaveData: return "saveData";
+        case Operation::CheckpointPause: return "checkpointPause";
+        case Operation::CalculateFines: return "calculateFines";
+    }
+    return "unknown";
+}
+
+// Values below SUB_BUCKETS get a bucket each; above, the top SUB_BITS + 1 bits
+// pick the bucket
+int LatencyHistogram::bucketOf(uint64_t nanos) {
+    if (nanos < SUB_BUCKETS) return static_cast<int>(nanos);
+    int exponent = 63 - __builtin_clzll(nanos);
+    int sub = static_cast<int>(nanos >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+uint64_t LatencyHistogram::bucketUpperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanos, bool refused) {
+    buckets[bucketOf(nanos)].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    if (refused) failed.fetch_add(1, memory_order_relaxed);
+    total.fetch_add(nanos, memory_order_relaxed);
+    uint64_t seen = maximum.load(memory_order_relaxed);
+    while (nanos > seen && !maximum.compare_exchange_weak(seen, nanos, memory_order_relaxed)) {
+    }
+}
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t n = getCount();
+    if (n == 0) return 0;
+    // Rank of the value, 1-based; the last bucket reached is the answer
+    uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(fraction * n + 0.5));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+        seen += buckets[bucket].load(memory_order_relaxed);
+        if (seen >= rank) return min(bucketUpperBound(bucket), getMax());
+    }
+    return getMax();
+}
+vector<pair<uint64_t, uint64_t>> LatencyHistogram::nonEmptyBuckets() const {
+    vector<pair<uint64_t, uint64_t>> found;
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+        uint64_t n = buckets[bucket].load(memory_order_relaxed);
+        if (n > 0) found.emplace_back(bucketUpperBound(bucket), n);
+    }
+    return found;
+}
+
+void Metrics::report(ostream& out) const {
+    out << left << setw(16) << "Operation" << right << setw(10) << "Count" << setw(8) << "Failed"
+        << setw(12) << "p50" << setw(12) << "p99" << setw(12) << "max" << setw(12) << "mean" << '\n';
+    for (Operation op : ALL_OPERATIONS) {
+        const LatencyHistogram& h = of(op);
+        out << left << setw(16) << operationName(op) << right << setw(10) << h.getCount() << setw(8) << h.getFailed();
+        if (h.getCount() == 0) {
+            out << setw(12) << "-" << setw(12) << "-" << setw(12) << "-" << setw(12) << "-" << '\n';
+            continue;
+        }
+        out << setw(12) << formatNanos(h.percentile(0.5)) << setw(12) << formatNanos(h.percentile(0.99))
+            << setw(12) << formatNanos(h.getMax()) << setw(12) << formatNanos(h.getTotal() / h.getCount()) << '\n';
+    }
+}
+bool Metrics::writeFile(const string& path) const {
+    ofstream out(path);
+    if (!out) return false;
+    out << "operation\tcount\tfailed\ttotal_ns\tp50_ns\tp99_ns\tmax_ns\tbuckets\n";
+    for (Operation op : ALL_OPERATIONS) {
+        const LatencyHistogram& h = of(op);
+        out << operationName(op) << '\t' << h.getCount() << '\t' << h.getFailed() << '\t' << h.getTotal() << '\t'
+            << h.percentile(0.5) << '\t' << h.percentile(0.99) << '\t' << h.getMax() << '\t';
+        const char* sep = "";
+        for (const auto& bucket : h.nonEmptyBuckets()) {
+            out << sep << bucket.first << ':' << bucket.second;
+            sep = ",";
+        }
+        out << '\n';
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,151 @@
+#include "lms.h"
+#include <charconv>
+// ReportWriter implementation
+/*
+CSV fields are quoted when they contain a comma, a quote, a line break or
+spaces at either end (a quote inside is doubled), so the files read back
+with any CSV reader, including TextLoader's. JSON strings are escaped as in
+RFC 8259; numbers are written as numbers and dates as strings.
+*/
+using namespace std;
+
+namespace {
+
+const char* const REPORT_NAMES[] = {"overdue", "fines", "circulation", "activity"};
+
+string lowercase(string text) {
+    for (char& c : text) c = tolower(static_cast<unsigned char>(c));
+    return text;
+}
+
+void appendCsv(string& out, string_view value) {
+    bool quote = !value.empty() && (value.front() == ' ' || value.back() == ' ');
+    for (char c : value) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        out.append(value);
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+void appendJson(string& out, string_view value) {
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += HEX[(c >> 4) & 0xf];
+                    out += HEX[c & 0xf];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+bool reportFromName(const string& name, Report& report) {
+    string lower = lowercase(name);
+    for (size_t i = 0; i < sizeof(REPORT_NAMES) / sizeof(REPORT_NAMES[0]); ++i) {
+        if (lower == REPORT_NAMES[i]) {
+            report = static_cast<Report>(i);
+            return true;
+        }
+    }
+    return false;
+}
+bool reportFormatFromName(const string& name, ReportFormat& format) {
+    string lower = lowercase(name);
+    if (lower == "csv") format = ReportFormat::CSV;
+    else if (lower == "json") format = ReportFormat::JSON;
+    else return false;
+    return true;
+}
+
+ReportWriter::ReportWriter(const string& path, ReportFormat format, vector<string> columns)
+    : path(path), out(path + ".tmp", ios::binary), format(format), columns(move(columns)) {
+    buffer.reserve(BUFFER_SIZE + 4096);
+    if (format == ReportFormat::CSV) {
+        for (size_t i = 0; i < this->columns.size(); ++i) {
+            if (i > 0) buffer += ',';
+            appendCsv(buffer, this->columns[i]);
+        }
+        buffer += '\n';
+    } else {
+        buffer += "[\n";
+    }
+}
+
+// Separator and, in JSON, the key of the next field
+void ReportWriter::beginField() {
+    if (format == ReportFormat::CSV) {
+        if (column > 0) buffer += ',';
+    } else {
+        buffer += column == 0 ? (rows == 0 ? "{" : ",\n{") : ",";
+        appendJson(buffer, columns[column]);
+        buffer += ':';
+    }
+    ++column;
+}
+void ReportWriter::flush() {
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+void ReportWriter::text(string_view value) {
+    beginField();
+    if (format == ReportFormat::CSV) appendCsv(buffer, value);
+    else appendJson(buffer, value);
+}
+void ReportWriter::number(long long value) {
+    beginField();
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+void ReportWriter::number(double value) {
+    beginField();
+    char digits[32];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+void ReportWriter::date(time_t value) {
+    char formatted[32];
+    tm parts;
+    gmtime_r(&value, &parts);
+    size_t length = strftime(formatted, sizeof(formatted), "%Y-%m-%dT%H:%M:%SZ", &parts);
+    text(string_view(formatted, length));
+}
+void ReportWriter::endRow() {
+    buffer += format == ReportFormat::CSV ? "\n" : "}";
+    column = 0;
+    ++rows;
+    if (buffer.size() >= BUFFER_SIZE) flush();
+}
+
+bool ReportWriter::finish() {
+    if (format == ReportFormat::JSON) buffer += rows == 0 ? "]\n" : "\n]\n";
+    flush();
+    out.close();
+    if (!out) return false;
+    return replaceFile(path + ".tmp", path);
+}
@@ -0,0 +1,112 @@
+#include "lms.h"
+#include <charconv>
+// Role policy table implementation
+/*
+roles.txt (optional, in the data directory) has one role per line:
+    <name>|<plural>|<max books>|<loan days>|<fine per day>|<max overdue days>|<librarian>
+Empty lines and lines starting with '#' are skipped. A max books of 0 means
+the role cannot borrow or reserve, a fine of 0 that it is never fined, and a
+max overdue days of "-" that overdue loans do not stop new ones. <librarian> is
+"yes" for roles that manage books, users and fines, otherwise "no".
+Student, Faculty and Librarian keep their built-in rules unless a line
+redefines them (names are matched ignoring case); other names add roles, numbered from 3 in the order of the
+file (the snapshot stores the numbers, so new roles go at the end).
+*/
+using namespace std;
+
+namespace {
+
+const vector<RolePolicy> BUILT_IN_ROLES = {
+    {"Student", "Students", 3, 15, 10, -1, false},
+    {"Faculty", "Faculty members", 5, 30, 0, 60, false},
+    {"Librarian", "Librarians", 0, 0, 0, -1, true},
+};
+const size_t MAX_ROLES = 256; // UserRole is one byte
+
+vector<RolePolicy> policies = BUILT_IN_ROLES; // indexed by UserRole
+
+bool parseCount(const string& text, int& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size() && value >= 0;
+}
+
+bool parsePolicy(const string& line, RolePolicy& policy, string& problem) {
+    vector<string> f;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('|', start);
+        f.push_back(line.substr(start, end == string::npos ? string::npos : end - start));
+        if (end == string::npos) break;
+        start = end + 1;
+    }
+    if (f.size() != 7) {
+        problem = "expected 7 fields separated by '|'";
+        return false;
+    }
+    policy.name = f[0];
+    policy.plural = f[1];
+    if (policy.name.empty() || policy.plural.empty()) problem = "empty role name";
+    else if (!parseCount(f[2], policy.maxBooks)) problem = "invalid max books " + f[2];
+    else if (!parseCount(f[3], policy.loanDays)) problem = "invalid loan days " + f[3];
+    else if (!parseCount(f[4], policy.fineRate)) problem = "invalid fine " + f[4];
+    else if (f[5] != "-" && !parseCount(f[5], policy.maxOverdueDays)) problem = "invalid max overdue days " + f[5];
+    else if (f[6] != "yes" && f[6] != "no") problem = "librarian must be yes or no";
+    if (!problem.empty()) return false;
+    if (f[5] == "-") policy.maxOverdueDays = -1;
+    policy.manages = f[6] == "yes";
+    return true;
+}
+
+} // namespace
+
+const RolePolicy& rolePolicy(UserRole role) {
+    size_t index = static_cast<size_t>(role);
+    return index < policies.size() ? policies[index] : policies[0];
+}
+size_t roleCount() {
+    return policies.size();
+}
+
+string userRoleName(UserRole role) {
+    return rolePolicy(role).name;
+}
+// Case-insensitive, so "student" in a CSV file or a batch command is a Student
+bool userRoleFromName(string_view name, UserRole& role) {
+    auto sameName = [name](const string& other) {
+        return other.size() == name.size() &&
+               equal(other.begin(), other.end(), name.begin(), [](char a, char b) {
+                   return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+               });
+    };
+    for (size_t i = 0; i < policies.size(); ++i) {
+        if (sameName(policies[i].name)) {
+            role = static_cast<UserRole>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool loadRolePolicies(const string& path, vector<string>& errors) {
+    policies = BUILT_IN_ROLES;
+    ifstream inFile(path);
+    if (!inFile) return false;
+    string line;
+    for (size_t lineNo = 1; getline(inFile, line); ++lineNo) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        RolePolicy policy;
+        string problem;
+        UserRole role;
+        if (!parsePolicy(line, policy, problem)) {
+            errors.push_back("roles.txt:" + to_string(lineNo) + ": " + problem);
+        } else if (userRoleFromName(policy.name, role)) {
+            policies[static_cast<size_t>(role)] = policy;
+        } else if (policies.size() == MAX_ROLES) {
+            errors.push_back("roles.txt:" + to_string(lineNo) + ": too many roles");
+        } else {
+            policies.push_back(policy);
+        }
+    }
+    return true;
+}
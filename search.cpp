@@ -0,0 +1,287 @@
+#include "lms.h"
+#include <cctype>
+#include <set>
+// TokenIndex, TrigramIndex and CatalogOrder class implementation
+using namespace std;
+
+namespace {
+
+// Distinct terms of the searchable fields of a book
+set<string> bookTerms(const Book& book) {
+    set<string> terms;
+    for (const string& field : {book.getTitle(), book.getAuthor(), book.getISBN()}) {
+        for (auto& term : TokenIndex::tokenize(field))
+            terms.insert(move(term));
+    }
+    return terms;
+}
+
+// Distinct trigrams of the searchable fields of a book. Trigrams are taken per
+// field since a substring match never spans two fields.
+vector<uint32_t> bookTrigrams(const Book& book) {
+    vector<uint32_t> grams;
+    for (const string& field : {book.getTitle(), book.getAuthor(), book.getISBN()}) {
+        vector<uint32_t> fieldGrams = TrigramIndex::trigrams(field);
+        grams.insert(grams.end(), fieldGrams.begin(), fieldGrams.end());
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+// Intersect sorted posting lists, starting from the shortest
+vector<BookId> intersectPostings(vector<const vector<BookId>*> lists) {
+    if (lists.empty()) return {};
+    sort(lists.begin(), lists.end(),
+         [](const vector<BookId>* a, const vector<BookId>* b) { return a->size() < b->size(); });
+    vector<BookId> result = *lists[0];
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        const vector<BookId>& other = *lists[i];
+        vector<BookId> kept;
+        kept.reserve(result.size());
+        for (BookId id : result) {
+            if (binary_search(other.begin(), other.end(), id))
+                kept.push_back(id);
+        }
+        result.swap(kept);
+    }
+    return result;
+}
+
+void insertSorted(vector<BookId>& list, BookId id) {
+    auto it = lower_bound(list.begin(), list.end(), id);
+    if (it == list.end() || *it != id) list.insert(it, id);
+}
+
+void eraseSorted(vector<BookId>& list, BookId id) {
+    auto it = lower_bound(list.begin(), list.end(), id);
+    if (it != list.end() && *it == id) list.erase(it);
+}
+
+} // namespace
+
+vector<string> TokenIndex::tokenize(const string& text) {
+    vector<string> tokens;
+    string current;
+    for (unsigned char c : text) {
+        if (isalnum(c)) {
+            current += static_cast<char>(tolower(c));
+        } else if (!current.empty()) {
+            tokens.push_back(move(current));
+            current.clear();
+        }
+    }
+    if (!current.empty()) tokens.push_back(move(current));
+    return tokens;
+}
+
+void TokenIndex::addBook(BookId id, const Book& book) {
+    for (const auto& term : bookTerms(book))
+        insertSorted(postings[term], id);
+}
+
+void TokenIndex::removeBook(BookId id, const Book& book) {
+    for (const auto& term : bookTerms(book)) {
+        auto found = postings.find(term);
+        if (found == postings.end()) continue;
+        eraseSorted(found->second, id);
+        if (found->second.empty()) postings.erase(found);
+    }
+}
+
+void TokenIndex::clear() {
+    postings.clear();
+}
+
+void TokenIndex::build(const BookTable& books) {
+    postings.clear();
+    // Appending in ID order keeps every posting list sorted
+    for (const auto* entry : books.inKeyOrder()) {
+        for (const auto& term : bookTerms(entry->second))
+            postings[term].push_back(entry->first);
+    }
+}
+
+vector<BookId> TokenIndex::query(const vector<string>& terms) const {
+    vector<const vector<BookId>*> lists;
+    for (const auto& term : terms) {
+        auto it = postings.find(term);
+        if (it == postings.end()) return {};
+        lists.push_back(&it->second);
+    }
+    return intersectPostings(lists);
+}
+
+vector<uint32_t> TrigramIndex::trigrams(const string& text) {
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        grams.push_back((static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << 16) |
+                        (static_cast<uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8) |
+                        static_cast<uint32_t>(static_cast<unsigned char>(text[i + 2])));
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+void TrigramIndex::addBook(BookId id, const Book& book) {
+    for (uint32_t gram : bookTrigrams(book))
+        insertSorted(postings[gram], id);
+}
+
+void TrigramIndex::removeBook(BookId id, const Book& book) {
+    for (uint32_t gram : bookTrigrams(book)) {
+        auto found = postings.find(gram);
+        if (found == postings.end()) continue;
+        eraseSorted(found->second, id);
+        if (found->second.empty()) postings.erase(found);
+    }
+}
+
+void TrigramIndex::clear() {
+    postings.clear();
+}
+
+void TrigramIndex::build(const BookTable& books) {
+    postings.clear();
+    for (const auto* entry : books.inKeyOrder()) {
+        for (uint32_t gram : bookTrigrams(entry->second))
+            postings[gram].push_back(entry->first);
+    }
+}
+
+vector<BookId> TrigramIndex::candidates(const string& keyword) const {
+    vector<const vector<BookId>*> lists;
+    for (uint32_t gram : trigrams(keyword)) {
+        auto it = postings.find(gram);
+        if (it == postings.end()) return {};
+        lists.push_back(&it->second);
+    }
+    return intersectPostings(lists);
+}
+
+string bookOrderName(BookOrder order) {
+    switch (order) {
+        case BookOrder::ISBN: return "ISBN";
+        case BookOrder::Title: return "title";
+        case BookOrder::Author: return "author";
+        case BookOrder::Publisher: return "publisher";
+        case BookOrder::Year: return "year";
+        case BookOrder::DueDate: return "due date";
+    }
+    return "ISBN";
+}
+bool bookOrderFromName(const string& name, BookOrder& order) {
+    string lower = name;
+    transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
+    if (lower == "isbn") order = BookOrder::ISBN;
+    else if (lower == "title") order = BookOrder::Title;
+    else if (lower == "author") order = BookOrder::Author;
+    else if (lower == "publisher") order = BookOrder::Publisher;
+    else if (lower == "year") order = BookOrder::Year;
+    else if (lower == "due") order = BookOrder::DueDate;
+    else return false;
+    return true;
+}
+
+CatalogOrder::CatalogOrder(const BookTable& books, const BookIdTable& bookIds)
+    : books(books), bookIds(bookIds) {}
+
+bool CatalogOrder::less(size_t order, const Book& a, BookId idA, const Book& b, BookId idB) const {
+    switch (static_cast<BookOrder>(order)) {
+        case BookOrder::Title:
+            if (int c = a.getTitle().compare(b.getTitle())) return c < 0;
+            break;
+        case BookOrder::Author:
+            if (int c = a.getAuthor().compare(b.getAuthor())) return c < 0;
+            break;
+        case BookOrder::Publisher:
+            if (int c = a.getPublisher().compare(b.getPublisher())) return c < 0;
+            break;
+        case BookOrder::Year:
+            if (a.getYear() != b.getYear()) return a.getYear() < b.getYear();
+            break;
+        default:
+            break;
+    }
+    return bookIds.getKey(idA) < bookIds.getKey(idB);
+}
+
+void CatalogOrder::addBook(BookId id, const Book& book) {
+    for (size_t order = 0; order < ORDERS; ++order) {
+        vector<BookId>& ids = sorted[order];
+        auto pos = lower_bound(ids.begin(), ids.end(), id, [&](BookId other, BookId) {
+            return less(order, books.find(other)->second, other, book, id);
+        });
+        ids.insert(pos, id);
+    }
+}
+
+void CatalogOrder::removeBook(BookId id, const Book& book) {
+    for (size_t order = 0; order < ORDERS; ++order) {
+        vector<BookId>& ids = sorted[order];
+        // Other books compare by their stored values, this one by the values it was added with
+        auto pos = lower_bound(ids.begin(), ids.end(), id, [&](BookId other, BookId) {
+            return other != id && less(order, books.find(other)->second, other, book, id);
+        });
+        if (pos != ids.end() && *pos == id) ids.erase(pos);
+    }
+}
+
+void CatalogOrder::addBooks(vector<BookId> added) {
+    for (size_t order = 0; order < ORDERS; ++order) {
+        auto before = [&](BookId a, BookId b) {
+            return less(order, books.find(a)->second, a, books.find(b)->second, b);
+        };
+        sort(added.begin(), added.end(), before);
+        vector<BookId>& ids = sorted[order];
+        size_t middle = ids.size();
+        ids.insert(ids.end(), added.begin(), added.end());
+        inplace_merge(ids.begin(), ids.begin() + middle, ids.end(), before);
+    }
+}
+
+void CatalogOrder::clear() {
+    for (auto& ids : sorted) ids.clear();
+}
+
+void CatalogOrder::build() {
+    vector<pair<BookId, const Book*>> entries;
+    entries.reserve(books.size());
+    for (const auto& entry : books) entries.emplace_back(entry.first, &entry.second);
+    for (size_t order = 0; order < ORDERS; ++order) {
+        sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) {
+            return less(order, *a.second, a.first, *b.second, b.first);
+        });
+        sorted[order].clear();
+        sorted[order].reserve(entries.size());
+        for (const auto& entry : entries) sorted[order].push_back(entry.first);
+    }
+}
+
+const vector<BookId>& CatalogOrder::ids(BookOrder order) const {
+    return sorted[static_cast<size_t>(order)];
+}
+
+pair<size_t, size_t> CatalogOrder::equalRange(BookOrder order, const string& value) const {
+    const vector<BookId>& sortedIds = ids(order);
+    auto field = [&](BookId id) -> const string& {
+        const Book& book = books.find(id)->second;
+        return order == BookOrder::Author ? book.getAuthor() : book.getPublisher();
+    };
+    auto first = lower_bound(sortedIds.begin(), sortedIds.end(), value,
+                             [&](BookId id, const string& v) { return field(id) < v; });
+    auto last = upper_bound(first, sortedIds.end(), value,
+                            [&](const string& v, BookId id) { return v < field(id); });
+    return {first - sortedIds.begin(), last - sortedIds.begin()};
+}
+
+pair<size_t, size_t> CatalogOrder::yearRange(int fromYear, int toYear) const {
+    const vector<BookId>& sortedIds = ids(BookOrder::Year);
+    auto year = [&](BookId id) { return books.find(id)->second.getYear(); };
+    auto first = lower_bound(sortedIds.begin(), sortedIds.end(), fromYear,
+                             [&](BookId id, int y) { return year(id) < y; });
+    auto last = upper_bound(first, sortedIds.end(), toYear,
+                            [&](int y, BookId id) { return y < year(id); });
+    return {first - sortedIds.begin(), last - sortedIds.begin()};
+}
@@ -0,0 +1,480 @@
+#include "lms.h"
+#include <cstring>
+#include <unordered_map>
+#include <filesystem>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+// Snapshot class implementation
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'L', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t ENDIAN_MARK = 0x01020304;
+
+// Reference to a string stored in the heap section
+struct StrRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endianMark;
+    uint64_t bookCount;
+    uint64_t userCount;
+    uint64_t accountCount;
+    uint64_t bookIdCount;  // entries of the BookId table
+    uint64_t copyCount;    // copy records of all books
+    uint64_t loanCount;    // CopyIds of the current loans of the accounts
+    uint64_t bookIdsOffset;
+    uint64_t booksOffset;
+    uint64_t copiesOffset;
+    uint64_t usersOffset;
+    uint64_t accountsOffset;
+    uint64_t loansOffset;
+    uint64_t accrualsOffset;  // int64 per loan: fines charged until (0: none)
+    uint64_t holdCount;       // entries of all hold queues
+    uint64_t holdsOffset;
+    uint64_t historiesOffset; // serialized history bitmaps of the accounts
+    uint64_t historiesSize;
+    uint64_t heapOffset;
+    uint64_t heapSize;
+    uint64_t journalSeq; // last journal entry already applied to this snapshot
+};
+
+// The ISBN is not stored: it follows from the book's ID via the BookId table
+struct BookRecord {
+    StrRef title;
+    StrRef author;
+    StrRef publisher;
+    int32_t year;
+    uint32_t id;         // BookId
+    uint32_t firstCopy;  // index into the copy records
+    uint32_t copyCount;
+};
+
+struct CopyRecord {
+    int32_t borrowerId;
+    uint8_t status; // BookStatus
+    uint8_t reserved[3];
+    int64_t borrowDate;
+    int64_t dueDate;
+};
+
+struct UserRecord {
+    StrRef name;
+    StrRef email;
+    StrRef password;
+    int32_t id;
+    uint8_t role; // UserRole
+    uint8_t reserved[3];
+};
+
+// One place in a hold queue; a queue's entries are stored in queue order
+struct HoldRecord {
+    uint32_t book; // BookId
+    int32_t userId;
+};
+
+struct AccountRecord {
+    int32_t userId;
+    uint32_t hasPaidFines;
+    double fines;
+    uint32_t borrowedFirst; // index into the loan array
+    uint32_t borrowedCount;
+    uint64_t historyOffset; // BookBitmap::serialize() bytes in the histories section
+    uint64_t historySize;
+};
+
+// Builds the string heap; identical strings (e.g. publishers) are stored once.
+class HeapBuilder {
+private:
+    string heap;
+    unordered_map<string, StrRef> seen;
+
+public:
+    StrRef add(const string& s) {
+        auto it = seen.find(s);
+        if (it != seen.end()) return it->second;
+        StrRef ref{static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(s.size())};
+        heap += s;
+        seen.emplace(s, ref);
+        return ref;
+    }
+    const string& data() const { return heap; }
+};
+
+// Read-only view of a whole file, memory-mapped where the platform allows it.
+class MappedFile {
+private:
+    const char* ptr = nullptr;
+    size_t length = 0;
+    string buffer; // fallback storage when mmap is unavailable
+    bool mapped = false;
+
+public:
+    bool open(const string& path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p != MAP_FAILED) {
+            ptr = static_cast<const char*>(p);
+            length = st.st_size;
+            mapped = true;
+            return true;
+        }
+#endif
+        ifstream inFile(path, ios::binary);
+        if (!inFile) return false;
+        ostringstream oss;
+        oss << inFile.rdbuf();
+        buffer = oss.str();
+        ptr = buffer.data();
+        length = buffer.size();
+        return length > 0;
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (mapped) munmap(const_cast<char*>(ptr), length);
+#endif
+    }
+    const char* data() const { return ptr; }
+    size_t size() const { return length; }
+};
+
+// Positions of the sections in SnapshotImage, in file order
+enum Section { HEADER, BOOK_IDS, BOOKS, COPIES, USERS, ACCOUNTS, LOANS, ACCRUALS, HOLDS, HISTORIES, HEAP, SECTION_COUNT };
+
+template <typename T>
+string bytesOf(const T* data, size_t count) {
+    return string(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+bool sectionFits(uint64_t offset, uint64_t count, size_t recordSize, size_t fileSize) {
+    if (offset > fileSize) return false;
+    return count <= (fileSize - offset) / recordSize;
+}
+
+} // namespace
+
+// Books and users are serialized on separate threads, each with its own
+// string heap; the heaps are concatenated and the users' references moved
+// past the books' heap. Only the number of copies of each book is needed
+// here, so firstCopy is known before the copies themselves are captured.
+SnapshotImage Snapshot::captureCatalog(const BookIdTable& bookIds, const BookTable& books, const UserTable& users) {
+    HeapBuilder bookHeap, userHeap;
+    vector<BookRecord> bookRecords;
+    vector<UserRecord> userRecords;
+
+    thread usersThread([&] {
+        userRecords.reserve(users.size());
+        for (const auto& pair : users) {
+            const User* user = pair.second;
+            UserRecord rec{};
+            rec.role = static_cast<uint8_t>(user->getRole());
+            rec.name = userHeap.add(user->getName());
+            rec.email = userHeap.add(user->getEmail());
+            rec.password = userHeap.add(user->getPassword());
+            rec.id = user->getId();
+            userRecords.push_back(rec);
+        }
+    });
+    bookRecords.reserve(books.size());
+    uint32_t copyCount = 0;
+    for (const auto& pair : books) {
+        const Book& book = pair.second;
+        BookRecord rec{};
+        rec.title = bookHeap.add(book.getTitle());
+        rec.author = bookHeap.add(book.getAuthor());
+        rec.publisher = bookHeap.add(book.getPublisher());
+        rec.id = pair.first;
+        rec.year = book.getYear();
+        rec.firstCopy = copyCount;
+        rec.copyCount = static_cast<uint32_t>(book.getCopyCount());
+        copyCount += rec.copyCount;
+        bookRecords.push_back(rec);
+    }
+    usersThread.join();
+
+    uint32_t userHeapBase = static_cast<uint32_t>(bookHeap.data().size());
+    for (UserRecord& rec : userRecords) {
+        rec.name.offset += userHeapBase;
+        rec.email.offset += userHeapBase;
+        rec.password.offset += userHeapBase;
+    }
+
+    SnapshotImage image;
+    image.sections.resize(SECTION_COUNT);
+    image.sections[BOOK_IDS] = bytesOf(bookIds.getKeys().data(), bookIds.size());
+    image.sections[BOOKS] = bytesOf(bookRecords.data(), bookRecords.size());
+    image.sections[USERS] = bytesOf(userRecords.data(), userRecords.size());
+    image.sections[HEAP] = bookHeap.data() + userHeap.data();
+    return image;
+}
+
+// Copies are captured on a second thread while the accounts are serialized,
+// walking the books in the same order as captureCatalog() did.
+void Snapshot::captureLoans(SnapshotImage& image, const BookTable& books, const AccountTable& accounts,
+                            const HoldQueues& holdQueues, uint64_t journalSeq) {
+    vector<CopyRecord> copyRecords;
+    vector<AccountRecord> accountRecords;
+    vector<CopyId> loans;
+    vector<int64_t> accruals;
+    vector<HoldRecord> holds;
+    string histories;
+
+    thread copiesThread([&] {
+        copyRecords.reserve(image.sections[BOOKS].size() / sizeof(BookRecord));
+        for (const auto& pair : books) {
+            const Book& book = pair.second;
+            for (uint32_t i = 0; i < book.getCopyCount(); ++i) {
+                const BookCopy& copy = book.getCopy(i);
+                CopyRecord copyRec{};
+                copyRec.status = static_cast<uint8_t>(copy.getStatus());
+                copyRec.borrowerId = copy.getBorrowerId();
+                copyRec.borrowDate = copy.getBorrowDate();
+                copyRec.dueDate = copy.getDueDate();
+                copyRecords.push_back(copyRec);
+            }
+        }
+    });
+    accountRecords.reserve(accounts.size());
+    for (const auto& pair : accounts) {
+        const Account& account = pair.second;
+        AccountRecord rec{};
+        rec.userId = account.getUserId();
+        rec.hasPaidFines = account.getHasPaidFines() ? 1 : 0;
+        rec.fines = account.getFines();
+        rec.borrowedFirst = static_cast<uint32_t>(loans.size());
+        for (CopyId loan : account.getBorrowedBooks()) {
+            loans.push_back(loan);
+            accruals.push_back(account.getAccruedUntil(loan));
+        }
+        rec.borrowedCount = static_cast<uint32_t>(loans.size()) - rec.borrowedFirst;
+        rec.historyOffset = histories.size();
+        account.getBorrowHistory().serialize(histories);
+        rec.historySize = histories.size() - rec.historyOffset;
+        accountRecords.push_back(rec);
+    }
+    for (const auto& entry : holdQueues) {
+        for (int userId : entry.second) holds.push_back(HoldRecord{entry.first, userId});
+    }
+    copiesThread.join();
+
+    vector<string>& sections = image.sections;
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.endianMark = ENDIAN_MARK;
+    header.bookCount = sections[BOOKS].size() / sizeof(BookRecord);
+    header.userCount = sections[USERS].size() / sizeof(UserRecord);
+    header.accountCount = accountRecords.size();
+    header.bookIdCount = sections[BOOK_IDS].size() / sizeof(uint64_t);
+    header.copyCount = copyRecords.size();
+    header.loanCount = loans.size();
+    header.bookIdsOffset = sizeof(SnapshotHeader);
+    header.booksOffset = header.bookIdsOffset + sections[BOOK_IDS].size();
+    header.copiesOffset = header.booksOffset + sections[BOOKS].size();
+    header.usersOffset = header.copiesOffset + copyRecords.size() * sizeof(CopyRecord);
+    header.accountsOffset = header.usersOffset + sections[USERS].size();
+    header.loansOffset = header.accountsOffset + accountRecords.size() * sizeof(AccountRecord);
+    header.accrualsOffset = header.loansOffset + loans.size() * sizeof(CopyId);
+    header.holdCount = holds.size();
+    header.holdsOffset = header.accrualsOffset + accruals.size() * sizeof(int64_t);
+    header.historiesOffset = header.holdsOffset + holds.size() * sizeof(HoldRecord);
+    header.historiesSize = histories.size();
+    header.heapOffset = header.historiesOffset + histories.size();
+    header.heapSize = sections[HEAP].size();
+    header.journalSeq = journalSeq;
+
+    sections[HEADER] = bytesOf(&header, 1);
+    sections[COPIES] = bytesOf(copyRecords.data(), copyRecords.size());
+    sections[ACCOUNTS] = bytesOf(accountRecords.data(), accountRecords.size());
+    sections[LOANS] = bytesOf(loans.data(), loans.size());
+    sections[ACCRUALS] = bytesOf(accruals.data(), accruals.size());
+    sections[HOLDS] = bytesOf(holds.data(), holds.size());
+    sections[HISTORIES] = move(histories);
+}
+
+bool Snapshot::writeImage(const string& path, const SnapshotImage& image) {
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile) return false;
+        for (const string& section : image.sections)
+            outFile.write(section.data(), static_cast<streamsize>(section.size()));
+        if (!outFile) return false;
+    }
+    return replaceFile(tempPath, path);
+}
+
+// fsync the new file before the rename, so that after a crash path holds
+// either the old or the complete new file, and fsync the directory after it,
+// so that the rename itself survives
+bool replaceFile(const string& tempPath, const string& path) {
+#ifndef _WIN32
+    int fd = ::open(tempPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    if (!synced) return false;
+#endif
+    error_code ec;
+    filesystem::rename(tempPath, path, ec);
+    if (ec) return false;
+#ifndef _WIN32
+    string dir = filesystem::path(path).parent_path().string();
+    int dirFd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+#endif
+    return true;
+}
+
+bool Snapshot::read(const string& path, BookIdTable& bookIds, BookTable& books,
+                    UserTable& users, AccountTable& accounts,
+                    HoldQueues& holdQueues, uint64_t& journalSeq) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(SnapshotHeader)) return false;
+
+    SnapshotHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != VERSION || header.endianMark != ENDIAN_MARK) {
+        return false;
+    }
+    size_t size = file.size();
+    if (!sectionFits(header.bookIdsOffset, header.bookIdCount, sizeof(uint64_t), size) ||
+        header.bookIdCount > UINT32_MAX ||
+        !sectionFits(header.booksOffset, header.bookCount, sizeof(BookRecord), size) ||
+        !sectionFits(header.copiesOffset, header.copyCount, sizeof(CopyRecord), size) ||
+        !sectionFits(header.usersOffset, header.userCount, sizeof(UserRecord), size) ||
+        !sectionFits(header.accountsOffset, header.accountCount, sizeof(AccountRecord), size) ||
+        !sectionFits(header.loansOffset, header.loanCount, sizeof(CopyId), size) ||
+        !sectionFits(header.accrualsOffset, header.loanCount, sizeof(int64_t), size) ||
+        !sectionFits(header.holdsOffset, header.holdCount, sizeof(HoldRecord), size) ||
+        !sectionFits(header.historiesOffset, header.historiesSize, 1, size) ||
+        !sectionFits(header.heapOffset, header.heapSize, 1, size)) {
+        return false;
+    }
+
+    const char* heap = file.data() + header.heapOffset;
+    bool valid = true;
+    auto str = [&](const StrRef& ref) -> string {
+        if (static_cast<uint64_t>(ref.offset) + ref.length > header.heapSize) {
+            valid = false;
+            return string();
+        }
+        return string(heap + ref.offset, ref.length);
+    };
+    // Records are read with memcpy since the mapping gives no alignment guarantee
+    auto record = [&](uint64_t offset, uint64_t index, void* out, size_t recordSize) {
+        memcpy(out, file.data() + offset + index * recordSize, recordSize);
+    };
+
+    // Interning the keys in table order gives every ISBN its stored ID again
+    for (uint64_t i = 0; i < header.bookIdCount && valid; ++i) {
+        uint64_t key;
+        record(header.bookIdsOffset, i, &key, sizeof(key));
+        valid = bookIds.intern(key) == i;
+    }
+    books.reserve(header.bookCount);
+    users.reserve(header.userCount);
+    accounts.reserve(header.accountCount);
+    for (uint64_t i = 0; i < header.bookCount && valid; ++i) {
+        BookRecord rec;
+        record(header.booksOffset, i, &rec, sizeof(rec));
+        if (!bookIds.contains(rec.id) || rec.copyCount == 0 ||
+            static_cast<uint64_t>(rec.firstCopy) + rec.copyCount > header.copyCount) {
+            valid = false;
+            break;
+        }
+        Book book(str(rec.title), str(rec.author), str(rec.publisher), rec.year, bookIds.getISBN(rec.id),
+                  rec.copyCount);
+        for (uint32_t j = 0; j < rec.copyCount && valid; ++j) {
+            CopyRecord copyRec;
+            record(header.copiesOffset, rec.firstCopy + j, &copyRec, sizeof(copyRec));
+            valid = copyRec.status <= static_cast<uint8_t>(BookStatus::Reserved);
+            BookCopy copy;
+            copy.setStatus(static_cast<BookStatus>(copyRec.status));
+            copy.setBorrowerId(copyRec.borrowerId);
+            copy.setBorrowDate(static_cast<time_t>(copyRec.borrowDate));
+            copy.setDueDate(static_cast<time_t>(copyRec.dueDate));
+            book.setCopy(j, copy);
+        }
+        books.emplace(rec.id, move(book));
+    }
+    for (uint64_t i = 0; i < header.userCount && valid; ++i) {
+        UserRecord rec;
+        record(header.usersOffset, i, &rec, sizeof(rec));
+        if (rec.role >= roleCount()) {
+            valid = false;
+            break;
+        }
+        users.add(User(rec.id, str(rec.name), str(rec.email), str(rec.password), static_cast<UserRole>(rec.role)));
+    }
+    for (uint64_t i = 0; i < header.accountCount && valid; ++i) {
+        AccountRecord rec;
+        record(header.accountsOffset, i, &rec, sizeof(rec));
+        if (static_cast<uint64_t>(rec.borrowedFirst) + rec.borrowedCount > header.loanCount ||
+            rec.historyOffset > header.historiesSize || rec.historySize > header.historiesSize - rec.historyOffset) {
+            valid = false;
+            break;
+        }
+        vector<CopyId> borrowed(rec.borrowedCount);
+        if (rec.borrowedCount)
+            memcpy(borrowed.data(), file.data() + header.loansOffset + rec.borrowedFirst * sizeof(CopyId),
+                   rec.borrowedCount * sizeof(CopyId));
+        vector<int64_t> accrued(rec.borrowedCount);
+        if (rec.borrowedCount)
+            memcpy(accrued.data(), file.data() + header.accrualsOffset + rec.borrowedFirst * sizeof(int64_t),
+                   rec.borrowedCount * sizeof(int64_t));
+        for (CopyId loan : borrowed) valid = valid && bookIds.contains(loan.book);
+        BookBitmap history;
+        valid = valid && history.deserialize(file.data() + header.historiesOffset + rec.historyOffset, rec.historySize);
+        valid = valid && (history.empty() || bookIds.contains(history.maxId()));
+        Account account(rec.userId);
+        account.setFines(rec.fines);
+        account.setHasPaidFines(rec.hasPaidFines != 0);
+        account.setBorrowedBooks(borrowed);
+        for (size_t j = 0; j < borrowed.size(); ++j) {
+            if (accrued[j] != 0) account.setAccruedUntil(borrowed[j], static_cast<time_t>(accrued[j]));
+        }
+        account.setBorrowHistory(history);
+        accounts.emplace(rec.userId, move(account));
+    }
+
+    for (uint64_t i = 0; i < header.holdCount && valid; ++i) {
+        HoldRecord rec;
+        record(header.holdsOffset, i, &rec, sizeof(rec));
+        valid = books.count(rec.book) != 0;
+        if (valid) holdQueues[rec.book].push_back(rec.userId);
+    }
+
+    if (!valid) {
+        bookIds.clear();
+        books.clear();
+        users.clear();
+        accounts.clear();
+        holdQueues.clear();
+        return false;
+    }
+    journalSeq = header.journalSeq;
+    return true;
+}
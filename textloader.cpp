@@ -0,0 +1,614 @@
+#include "lms.h"
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+// TextLoader class implementation
+using namespace std;
+
+namespace {
+
+const size_t BOOK_LINES = 6;                 // title .. number of copies
+const size_t LEGACY_BOOK_LINES = 9;          // title .. ISBN, then status .. dueDate of the only copy
+const size_t USER_LINES = 5;                 // role, id, name, email, password
+const size_t MIN_CHUNK_BYTES = 1 << 20;      // smaller files are parsed by one thread
+const size_t ERROR_LIMIT = 1000;             // per chunk, so a wrong file cannot flood memory
+
+// A range of whole records; firstLine is the number of lines before begin
+struct Chunk {
+    const char* begin;
+    const char* end;
+    size_t firstLine;
+};
+
+struct ParsedBooks {
+    vector<pair<uint64_t, Book>> books; // ISBN key and book with its canonical ISBN
+    vector<string> errors;
+};
+
+struct ParsedUsers {
+    vector<User> users;
+    vector<string> errors;
+};
+
+struct ParsedLoan {
+    size_t line;         // for errors found while merging
+    uint64_t key;        // ISBN key
+    uint32_t copy;       // 0-based
+    time_t accruedUntil; // 0: no fines charged yet
+};
+
+struct ParsedAccount {
+    int userId;
+    double fines;
+    bool paid;
+    vector<ParsedLoan> borrowed;
+    vector<uint64_t> history;
+};
+
+struct ParsedAccounts {
+    vector<ParsedAccount> accounts;
+    vector<string> errors;
+};
+
+struct ParsedCopy {
+    size_t line;
+    uint64_t key;   // ISBN key
+    uint32_t copy;  // 0-based
+    BookCopy state;
+};
+
+struct ParsedQueue {
+    size_t line;          // of the ISBN, for errors found while merging
+    uint64_t key;         // ISBN key
+    vector<int> userIds;  // first in line first
+};
+
+bool readFile(const string& path, string& data) {
+    ifstream inFile(path, ios::binary);
+    if (!inFile) return false;
+    inFile.seekg(0, ios::end);
+    data.resize(static_cast<size_t>(inFile.tellg()));
+    inFile.seekg(0);
+    inFile.read(&data[0], static_cast<streamsize>(data.size()));
+    return static_cast<bool>(inFile);
+}
+
+// Hands out the lines of a chunk and counts them
+struct LineReader {
+    const char* pos;
+    const char* end;
+    size_t lineNo; // number of the line returned last
+
+    bool next(string_view& line) {
+        if (pos == end) return false;
+        const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        const char* stop = eol ? eol : end;
+        line = string_view(pos, stop - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        pos = eol ? eol + 1 : end;
+        ++lineNo;
+        return true;
+    }
+    // Nothing but whitespace left, e.g. the newline at the end of the file
+    bool done() const {
+        return all_of(pos, end, [](char c) { return isspace(static_cast<unsigned char>(c)); });
+    }
+};
+
+template <typename T>
+bool parseNumber(string_view text, T& value) {
+    const char* last = text.data() + text.size();
+    auto result = from_chars(text.data(), last, value);
+    return result.ec == errc() && result.ptr == last;
+}
+
+void addError(vector<string>& errors, const char* file, size_t line, const string& problem) {
+    if (errors.size() < ERROR_LIMIT)
+        errors.push_back(string(file) + ":" + to_string(line) + ": " + problem);
+}
+
+string quoted(string_view text) {
+    return "'" + string(text) + "'";
+}
+
+// Run fn(0) .. fn(count - 1) on count threads (fn(0) on the calling one)
+template <typename Fn>
+void parallelFor(size_t count, Fn fn) {
+    vector<thread> threads;
+    for (size_t i = 1; i < count; ++i) threads.emplace_back(fn, i);
+    fn(0);
+    for (auto& t : threads) t.join();
+}
+
+const char* nextLine(const char* pos, const char* end) {
+    const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    return eol ? eol + 1 : end;
+}
+
+// Split a file of fixed-size records into about one chunk per core. The byte
+// ranges are first moved to line starts, their newlines are counted in
+// parallel, and each start is then moved forward to the next record boundary.
+vector<Chunk> splitRecords(const string& data, size_t recordLines) {
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    size_t cores = max(1u, thread::hardware_concurrency());
+    size_t parts = max<size_t>(1, min(cores, data.size() / MIN_CHUNK_BYTES));
+
+    vector<const char*> starts(parts + 1, end);
+    starts[0] = begin;
+    for (size_t i = 1; i < parts; ++i)
+        starts[i] = max(starts[i - 1], nextLine(begin + data.size() * i / parts - 1, end));
+
+    vector<size_t> newlines(parts);
+    parallelFor(parts, [&](size_t i) { newlines[i] = count(starts[i], starts[i + 1], '\n'); });
+
+    vector<Chunk> chunks(parts, Chunk{begin, end, 0});
+    size_t linesBefore = 0;
+    for (size_t i = 0; i < parts; ++i) {
+        const char* start = starts[i];
+        size_t line = linesBefore;
+        for (; line % recordLines != 0 && start != end; ++line)
+            start = nextLine(start, end);
+        chunks[i].begin = start;
+        chunks[i].firstLine = line;
+        if (i > 0) chunks[i - 1].end = start;
+        linesBefore += newlines[i];
+    }
+    return chunks;
+}
+
+// The older books.txt has the status of the book where a record now ends
+// with its number of copies, so the sixth line tells the formats apart
+size_t bookRecordLines(const string& data) {
+    LineReader reader{data.data(), data.data() + data.size(), 0};
+    string_view line;
+    BookStatus status;
+    for (size_t i = 0; i < BOOK_LINES; ++i) {
+        if (!reader.next(line)) return BOOK_LINES;
+    }
+    return bookStatusFromName(line, status) ? LEGACY_BOOK_LINES : BOOK_LINES;
+}
+
+void parseBooks(const Chunk& chunk, size_t recordLines, ParsedBooks& out) {
+    LineReader reader{chunk.begin, chunk.end, chunk.firstLine};
+    string_view f[LEGACY_BOOK_LINES];
+    while (!reader.done()) {
+        size_t first = reader.lineNo + 1;
+        size_t n = 0;
+        while (n < recordLines && reader.next(f[n])) ++n;
+        if (n < recordLines) {
+            addError(out.errors, "books.txt", first, "incomplete book record");
+            break;
+        }
+        int year = 0, borrowerId = 0;
+        size_t copyCount = 0;
+        time_t borrowDate = 0, dueDate = 0;
+        BookStatus status;
+        uint64_t key;
+        if (!parseNumber(f[3], year))
+            addError(out.errors, "books.txt", first + 3, "invalid year " + quoted(f[3]));
+        else if (!parseISBN(f[4], key))
+            addError(out.errors, "books.txt", first + 4, "invalid ISBN " + quoted(f[4]));
+        else if (recordLines == BOOK_LINES) {
+            if (!parseNumber(f[5], copyCount) || copyCount == 0)
+                addError(out.errors, "books.txt", first + 5, "invalid number of copies " + quoted(f[5]));
+            else
+                out.books.emplace_back(key, Book(string(f[0]), string(f[1]), string(f[2]), year, formatISBN(key),
+                                                 copyCount));
+        } else if (!bookStatusFromName(f[5], status))
+            addError(out.errors, "books.txt", first + 5, "unknown status " + quoted(f[5]));
+        else if (!parseNumber(f[6], borrowerId))
+            addError(out.errors, "books.txt", first + 6, "invalid borrower ID " + quoted(f[6]));
+        else if (!parseNumber(f[7], borrowDate))
+            addError(out.errors, "books.txt", first + 7, "invalid borrow date " + quoted(f[7]));
+        else if (!parseNumber(f[8], dueDate))
+            addError(out.errors, "books.txt", first + 8, "invalid due date " + quoted(f[8]));
+        else {
+            BookCopy copy;
+            copy.setStatus(status);
+            copy.setBorrowerId(borrowerId);
+            copy.setBorrowDate(borrowDate);
+            copy.setDueDate(dueDate);
+            out.books.emplace_back(key, Book(string(f[0]), string(f[1]), string(f[2]), year, formatISBN(key)));
+            out.books.back().second.setCopy(0, copy);
+        }
+    }
+}
+
+void parseUsers(const Chunk& chunk, ParsedUsers& out) {
+    LineReader reader{chunk.begin, chunk.end, chunk.firstLine};
+    string_view f[USER_LINES];
+    while (!reader.done()) {
+        size_t first = reader.lineNo + 1;
+        size_t n = 0;
+        while (n < USER_LINES && reader.next(f[n])) ++n;
+        if (n < USER_LINES) {
+            addError(out.errors, "users.txt", first, "incomplete user record");
+            break;
+        }
+        UserRole role;
+        int id = 0;
+        if (!userRoleFromName(f[0], role))
+            addError(out.errors, "users.txt", first, "unknown role " + quoted(f[0]));
+        else if (!parseNumber(f[1], id))
+            addError(out.errors, "users.txt", first + 1, "invalid user ID " + quoted(f[1]));
+        else
+            out.users.emplace_back(id, string(f[2]), string(f[3]), string(f[4]), role);
+    }
+}
+
+// Accounts have variable length (two lists of ISBNs), so the file is parsed
+// by one thread. An unreadable count or number leaves no way to find the next
+// record, so the rest of the file is skipped then; a bad ISBN only loses that entry.
+void parseAccounts(const string& data, ParsedAccounts& out) {
+    LineReader reader{data.data(), data.data() + data.size(), 0};
+    string_view line;
+    auto number = [&](auto& value, const char* what) {
+        if (!reader.next(line)) {
+            addError(out.errors, "accounts.txt", reader.lineNo + 1,
+                     string("missing ") + what + "; skipping the rest of the file");
+            return false;
+        }
+        if (!parseNumber(line, value)) {
+            addError(out.errors, "accounts.txt", reader.lineNo,
+                     string("invalid ") + what + " " + quoted(line) + "; skipping the rest of the file");
+            return false;
+        }
+        return true;
+    };
+    // Reads "<count>" and count ISBN lines; a loan line may carry "#<copy>"
+    // and "\t<accruedUntil>"
+    auto isbns = [&](const char* what, auto add) {
+        int count = 0;
+        if (!number(count, what)) return false;
+        for (int i = 0; i < count; ++i) {
+            uint64_t key;
+            uint32_t copy = 1;
+            time_t accruedUntil = 0;
+            if (!reader.next(line)) {
+                addError(out.errors, "accounts.txt", reader.lineNo + 1, "missing ISBN");
+                return false;
+            }
+            size_t tab = line.find('\t');
+            size_t hash = line.substr(0, tab).find('#');
+            string_view isbn = line.substr(0, min(tab, hash));
+            if (!parseISBN(isbn, key))
+                addError(out.errors, "accounts.txt", reader.lineNo, "invalid ISBN " + quoted(isbn));
+            else if (hash != string_view::npos &&
+                     (!parseNumber(line.substr(hash + 1, tab - hash - 1), copy) || copy == 0))
+                addError(out.errors, "accounts.txt", reader.lineNo, "invalid copy " + quoted(line.substr(0, tab)));
+            else if (tab != string_view::npos && !parseNumber(line.substr(tab + 1), accruedUntil))
+                addError(out.errors, "accounts.txt", reader.lineNo, "invalid accrual time " + quoted(line.substr(tab + 1)));
+            else
+                add(key, copy - 1, accruedUntil);
+        }
+        return true;
+    };
+
+    while (!reader.done()) {
+        ParsedAccount account{0, 0.0, true, {}, {}};
+        int paid = 0;
+        if (!number(account.userId, "user ID") || !number(account.fines, "fine amount") ||
+            !number(paid, "paid flag") ||
+            !isbns("loan count", [&](uint64_t key, uint32_t copy, time_t until) {
+                account.borrowed.push_back(ParsedLoan{reader.lineNo, key, copy, until});
+            }) ||
+            !isbns("history count", [&](uint64_t key, uint32_t, time_t) { account.history.push_back(key); }))
+            break;
+        account.paid = (paid == 1);
+        out.accounts.push_back(move(account));
+    }
+}
+
+// copies.txt: one line per copy that is not Available,
+// "<ISBN>\t<copy>\t<status>\t<borrowerId>\t<borrowDate>\t<dueDate>".
+// Lines are independent, so a bad one is skipped on its own.
+void parseCopies(const string& data, vector<ParsedCopy>& copies, vector<string>& errors) {
+    LineReader reader{data.data(), data.data() + data.size(), 0};
+    string_view line;
+    while (reader.next(line)) {
+        if (line.empty()) continue;
+        string_view f[6];
+        size_t n = 0;
+        for (size_t start = 0; n < 6; ++n) {
+            size_t tab = line.find('\t', start);
+            f[n] = line.substr(start, tab - start);
+            if (tab == string_view::npos) {
+                ++n;
+                break;
+            }
+            start = tab + 1;
+        }
+        ParsedCopy copy{reader.lineNo, 0, 0, BookCopy()};
+        uint32_t number = 0;
+        int borrowerId = 0;
+        time_t borrowDate = 0, dueDate = 0;
+        BookStatus status;
+        if (n != 6)
+            addError(errors, "copies.txt", reader.lineNo, "expected 6 tab-separated fields");
+        else if (!parseISBN(f[0], copy.key))
+            addError(errors, "copies.txt", reader.lineNo, "invalid ISBN " + quoted(f[0]));
+        else if (!parseNumber(f[1], number) || number == 0)
+            addError(errors, "copies.txt", reader.lineNo, "invalid copy " + quoted(f[1]));
+        else if (!bookStatusFromName(f[2], status))
+            addError(errors, "copies.txt", reader.lineNo, "unknown status " + quoted(f[2]));
+        else if (!parseNumber(f[3], borrowerId) || !parseNumber(f[4], borrowDate) || !parseNumber(f[5], dueDate))
+            addError(errors, "copies.txt", reader.lineNo, "invalid borrower ID or date");
+        else {
+            copy.copy = number - 1;
+            copy.state.setStatus(status);
+            copy.state.setBorrowerId(borrowerId);
+            copy.state.setBorrowDate(borrowDate);
+            copy.state.setDueDate(dueDate);
+            copies.push_back(copy);
+        }
+    }
+}
+
+// reservations.txt: per book its ISBN, the number of waiting users and their
+// IDs, one per line. Like accounts.txt a broken count ends the parse.
+void parseReservations(const string& data, vector<ParsedQueue>& queues, vector<string>& errors) {
+    LineReader reader{data.data(), data.data() + data.size(), 0};
+    string_view line;
+    while (!reader.done()) {
+        ParsedQueue queue{reader.lineNo + 1, 0, {}};
+        int count = 0;
+        reader.next(line);
+        if (!parseISBN(line, queue.key)) {
+            addError(errors, "reservations.txt", reader.lineNo, "invalid ISBN " + quoted(line) + "; skipping the rest of the file");
+            return;
+        }
+        if (!reader.next(line) || !parseNumber(line, count) || count < 0) {
+            addError(errors, "reservations.txt", reader.lineNo, "invalid waitlist length; skipping the rest of the file");
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            int userId = 0;
+            if (!reader.next(line) || !parseNumber(line, userId)) {
+                addError(errors, "reservations.txt", reader.lineNo, "invalid user ID; skipping the rest of the file");
+                return;
+            }
+            queue.userIds.push_back(userId);
+        }
+        queues.push_back(move(queue));
+    }
+}
+
+// Split one CSV line into fields. A field may be quoted, with "" standing for
+// a quote, so that it can hold commas; unquoted fields are trimmed. Returns
+// false on an unterminated quote or text after a closing one.
+bool splitCsv(string_view line, vector<string>& fields) {
+    fields.clear();
+    size_t i = 0;
+    while (true) {
+        string field;
+        while (i < line.size() && line[i] == ' ') ++i;
+        if (i < line.size() && line[i] == '"') {
+            for (++i;; ++i) {
+                if (i == line.size()) return false;
+                if (line[i] != '"') field += line[i];
+                else if (i + 1 < line.size() && line[i + 1] == '"') field += line[++i];
+                else break;
+            }
+            ++i;
+            while (i < line.size() && line[i] == ' ') ++i;
+            if (i < line.size() && line[i] != ',') return false;
+        } else {
+            size_t stop = min(line.find(',', i), line.size());
+            string_view text = line.substr(i, stop - i);
+            while (!text.empty() && text.back() == ' ') text.remove_suffix(1);
+            field.assign(text);
+            i = stop;
+        }
+        fields.push_back(move(field));
+        if (i == line.size()) return true;
+        ++i; // the comma
+    }
+}
+
+// Parse the rows of a CSV file in parallel chunks of lines. parseRow(fields,
+// row) fills row and returns "" or describes the problem. A first line whose
+// first field is header (in any case) is skipped, as are blank lines.
+template <typename T, typename ParseRow>
+void parseCsv(const string& data, const string& file, const char* header, ParseRow parseRow, CsvRows<T>& result) {
+    vector<Chunk> chunks = splitRecords(data, 1);
+    vector<CsvRows<T>> parts(chunks.size());
+    parallelFor(chunks.size(), [&](size_t i) {
+        LineReader reader{chunks[i].begin, chunks[i].end, chunks[i].firstLine};
+        CsvRows<T>& out = parts[i];
+        vector<string> fields;
+        string_view line;
+        while (reader.next(line)) {
+            if (all_of(line.begin(), line.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }))
+                continue;
+            bool split = splitCsv(line, fields);
+            if (reader.lineNo == 1 && split && equal(fields[0].begin(), fields[0].end(), header, header + strlen(header),
+                                                     [](char a, char b) { return tolower(a) == b; }))
+                continue;
+            ++out.read;
+            T row{};
+            row.line = reader.lineNo;
+            string problem = split ? parseRow(fields, row) : "unterminated quote";
+            if (problem.empty()) {
+                out.rows.push_back(move(row));
+            } else {
+                ++out.rejected;
+                addError(out.errors, file.c_str(), reader.lineNo, problem);
+            }
+        }
+    });
+    for (auto& part : parts) {
+        result.read += part.read;
+        result.rejected += part.rejected;
+        move(part.rows.begin(), part.rows.end(), back_inserter(result.rows));
+        for (auto& error : part.errors) {
+            if (result.errors.size() < ERROR_LIMIT) result.errors.push_back(move(error));
+        }
+    }
+}
+
+// Keep the first row of each key; later ones are rejected
+template <typename T, typename Key, typename KeyOf>
+void dropDuplicates(CsvRows<T>& result, const string& file, const char* what, KeyOf keyOf) {
+    FlatHashMap<Key, size_t> firstLine;
+    firstLine.reserve(result.rows.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < result.rows.size(); ++i) {
+        T& row = result.rows[i];
+        auto seen = firstLine.emplace(keyOf(row), row.line);
+        if (!seen.second) {
+            ++result.rejected;
+            if (result.errors.size() < ERROR_LIMIT)
+                result.errors.push_back(file + ":" + to_string(row.line) + ": duplicate " + what + ", first on line " +
+                                        to_string(seen.first->second));
+            continue;
+        }
+        if (kept != i) result.rows[kept] = move(row);
+        ++kept;
+    }
+    result.rows.resize(kept);
+}
+
+} // namespace
+
+void TextLoader::load(const string& dir, BookIdTable& bookIds, BookTable& books,
+                      UserTable& users, AccountTable& accounts, HoldQueues& holdQueues,
+                      vector<string>& errors) {
+    string bookData, userData, accountData, copyData, reservationData;
+    bool haveBooks = false, haveUsers = false, haveAccounts = false;
+    vector<ParsedBooks> parsedBooks;
+    vector<ParsedUsers> parsedUsers;
+    ParsedAccounts parsedAccounts;
+    vector<ParsedCopy> parsedCopies;
+    vector<ParsedQueue> parsedQueues;
+    vector<string> copyErrors, queueErrors;
+
+    thread booksThread([&] {
+        if (!(haveBooks = readFile(dir + "/books.txt", bookData))) return;
+        size_t recordLines = bookRecordLines(bookData);
+        vector<Chunk> chunks = splitRecords(bookData, recordLines);
+        parsedBooks.resize(chunks.size());
+        parallelFor(chunks.size(), [&](size_t i) { parseBooks(chunks[i], recordLines, parsedBooks[i]); });
+    });
+    thread usersThread([&] {
+        if (!(haveUsers = readFile(dir + "/users.txt", userData))) return;
+        vector<Chunk> chunks = splitRecords(userData, USER_LINES);
+        parsedUsers.resize(chunks.size());
+        parallelFor(chunks.size(), [&](size_t i) { parseUsers(chunks[i], parsedUsers[i]); });
+    });
+    if ((haveAccounts = readFile(dir + "/accounts.txt", accountData)))
+        parseAccounts(accountData, parsedAccounts);
+    if (readFile(dir + "/copies.txt", copyData)) // optional
+        parseCopies(copyData, parsedCopies, copyErrors);
+    if (readFile(dir + "/reservations.txt", reservationData)) // optional
+        parseReservations(reservationData, parsedQueues, queueErrors);
+    booksThread.join();
+    usersThread.join();
+
+    if (!haveBooks) errors.push_back("books.txt not found. Starting with empty library.");
+    if (!haveUsers) errors.push_back("users.txt not found. Starting with no users.");
+    if (!haveAccounts) errors.push_back("accounts.txt not found. Starting with no accounts.");
+
+    // Merge in file order: books first, so they get the same IDs as before
+    size_t bookCount = 0, userCount = 0;
+    for (const auto& part : parsedBooks) bookCount += part.books.size();
+    for (const auto& part : parsedUsers) userCount += part.users.size();
+    books.reserve(bookCount);
+    users.reserve(userCount);
+    accounts.reserve(parsedAccounts.accounts.size());
+
+    for (auto& part : parsedBooks) {
+        for (auto& entry : part.books)
+            books[bookIds.intern(entry.first)] = move(entry.second);
+        errors.insert(errors.end(), part.errors.begin(), part.errors.end());
+    }
+    for (const auto& copy : parsedCopies) {
+        BookId id;
+        auto book = bookIds.find(copy.key, id) ? books.find(id) : books.end();
+        if (book == books.end() || copy.copy >= book->second.getCopyCount()) {
+            addError(errors, "copies.txt", copy.line, "no copy " + to_string(copy.copy + 1) + " of " + formatISBN(copy.key));
+            continue;
+        }
+        book->second.setCopy(copy.copy, copy.state);
+    }
+    errors.insert(errors.end(), copyErrors.begin(), copyErrors.end());
+    for (auto& part : parsedUsers) {
+        for (User& user : part.users) users.add(move(user));
+        errors.insert(errors.end(), part.errors.begin(), part.errors.end());
+    }
+    for (const auto& parsed : parsedAccounts.accounts) {
+        Account account(parsed.userId);
+        account.setFines(parsed.fines);
+        account.setHasPaidFines(parsed.paid);
+        // A loan must be of a copy of a cataloged book; interning its ISBN
+        // otherwise would add an ID that no book uses
+        for (const auto& loan : parsed.borrowed) {
+            BookId id;
+            auto book = bookIds.find(loan.key, id) ? books.find(id) : books.end();
+            if (book == books.end()) {
+                addError(errors, "accounts.txt", loan.line, "loan of " + formatISBN(loan.key) + ", which is not cataloged");
+                continue;
+            }
+            if (loan.copy >= book->second.getCopyCount()) {
+                addError(errors, "accounts.txt", loan.line,
+                         "loan of copy " + to_string(loan.copy + 1) + " of " + formatISBN(loan.key) + ", which has no such copy");
+                continue;
+            }
+            CopyId copy{id, loan.copy};
+            account.addBorrowedBook(copy);
+            if (loan.accruedUntil != 0) account.setAccruedUntil(copy, loan.accruedUntil);
+        }
+        for (uint64_t key : parsed.history) account.addToBorrowHistory(bookIds.intern(key));
+        accounts[parsed.userId] = move(account);
+    }
+    errors.insert(errors.end(), parsedAccounts.errors.begin(), parsedAccounts.errors.end());
+    for (const auto& queue : parsedQueues) {
+        BookId id;
+        if (!bookIds.find(queue.key, id) || !books.count(id)) {
+            addError(errors, "reservations.txt", queue.line, "no such book " + formatISBN(queue.key));
+            continue;
+        }
+        if (queue.userIds.empty()) continue;
+        holdQueues[id].assign(queue.userIds.begin(), queue.userIds.end());
+    }
+    errors.insert(errors.end(), queueErrors.begin(), queueErrors.end());
+}
+
+bool TextLoader::loadBookCsv(const string& path, CsvRows<CsvBook>& result) {
+    string data;
+    if (!readFile(path, data)) return false;
+    string file = filesystem::path(path).filename().string();
+    parseCsv(data, file, "title", [](const vector<string>& f, CsvBook& row) -> string {
+        int year = 0;
+        size_t copies = 1;
+        if (f.size() != 5 && f.size() != 6) return "expected 5 or 6 fields, found " + to_string(f.size());
+        if (f[0].empty()) return "empty title";
+        if (!parseNumber(string_view(f[3]), year)) return "invalid year " + quoted(string_view(f[3]));
+        if (!parseISBN(f[4], row.key)) return "invalid ISBN " + quoted(string_view(f[4]));
+        if (f.size() == 6 && (!parseNumber(string_view(f[5]), copies) || copies == 0))
+            return "invalid number of copies " + quoted(string_view(f[5]));
+        row.book = Book(f[0], f[1], f[2], year, formatISBN(row.key), copies);
+        return "";
+    }, result);
+    dropDuplicates<CsvBook, uint64_t>(result, file, "ISBN", [](const CsvBook& row) { return row.key; });
+    return true;
+}
+
+bool TextLoader::loadUserCsv(const string& path, CsvRows<CsvUser>& result) {
+    string data;
+    if (!readFile(path, data)) return false;
+    string file = filesystem::path(path).filename().string();
+    parseCsv(data, file, "role", [](const vector<string>& f, CsvUser& row) -> string {
+        UserRole role;
+        int id = 0;
+        if (f.size() != 5) return "expected 5 fields, found " + to_string(f.size());
+        if (!userRoleFromName(f[0], role)) return "unknown role " + quoted(string_view(f[0]));
+        if (!parseNumber(string_view(f[1]), id) || id <= 0) return "invalid user ID " + quoted(string_view(f[1]));
+        if (f[2].empty()) return "empty name";
+        row.user = User(id, f[2], f[3], f[4], role);
+        return "";
+    }, result);
+    dropDuplicates<CsvUser, int>(result, file, "user ID", [](const CsvUser& row) { return row.user.getId(); });
+    return true;
+}
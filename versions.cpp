@@ -0,0 +1,56 @@
+#include "lms.h"
+// CatalogVersions class implementation
+using namespace std;
+
+CatalogVersions::View::View(const CatalogVersions& versions) : versions(versions) {
+    lock_guard<mutex> guard(versions.commitMutex);
+    seq = versions.lastSeq;
+    versions.openViews.insert(seq);
+}
+CatalogVersions::View::~View() {
+    lock_guard<mutex> guard(versions.commitMutex);
+    versions.openViews.erase(versions.openViews.find(seq));
+}
+// Versions newer than the view are skipped; the chain reaches back to the
+// view's version since publish() never cuts it in front of an open view
+shared_ptr<const CatalogVersions::Version> CatalogVersions::View::find(BookId id) const {
+    if (id >= versions.heads.size()) return nullptr;
+    shared_ptr<const Version> version = atomic_load(&versions.heads[id]);
+    while (version && version->seq > seq)
+        version = atomic_load(&version->older);
+    return version;
+}
+
+void CatalogVersions::publish(BookId id, const vector<BookCopy>& copies) {
+    auto version = make_shared<Version>();
+    version->copies = copies; // copied before taking the lock
+    lock_guard<mutex> guard(commitMutex);
+    if (id >= heads.size()) heads.resize(id + 1); // new books only, no View is open
+    version->seq = ++lastSeq;
+    shared_ptr<const Version> previous = atomic_load(&heads[id]);
+    if (previous && !openViews.empty()) {
+        // The oldest view stops at the first version at or before it, so
+        // anything older than that can go
+        version->older = previous;
+        uint64_t oldest = *openViews.begin();
+        for (shared_ptr<const Version> v = previous; v; v = atomic_load(&v->older)) {
+            if (v->seq <= oldest) {
+                atomic_store(&v->older, shared_ptr<const Version>());
+                break;
+            }
+        }
+    }
+    atomic_store(&heads[id], shared_ptr<const Version>(move(version)));
+}
+void CatalogVersions::erase(BookId id) {
+    lock_guard<mutex> guard(commitMutex);
+    if (id < heads.size()) heads[id].reset();
+}
+void CatalogVersions::clear() {
+    lock_guard<mutex> guard(commitMutex);
+    heads.clear();
+}
+shared_ptr<const CatalogVersions::Version> CatalogVersions::newest(BookId id) const {
+    lock_guard<mutex> guard(commitMutex);
+    return id < heads.size() ? atomic_load(&heads[id]) : nullptr;
+}